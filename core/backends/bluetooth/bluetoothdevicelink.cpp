@@ -7,12 +7,12 @@
 #include "bluetoothdevicelink.h"
 
 #include "../linkprovider.h"
+#include "backends/multiplexer/connectionmultiplexer.h"
+#include "backends/multiplexer/multiplexchannel.h"
 #include "bluetoothdownloadjob.h"
 #include "bluetoothlinkprovider.h"
 #include "bluetoothuploadjob.h"
-#include "connectionmultiplexer.h"
 #include "core_debug.h"
-#include "multiplexchannel.h"
 
 BluetoothDeviceLink::BluetoothDeviceLink(const DeviceInfo &deviceInfo,
                                          BluetoothLinkProvider *parent,
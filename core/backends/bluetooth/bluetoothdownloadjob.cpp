@@ -5,13 +5,13 @@
  */
 
 #include "bluetoothdownloadjob.h"
-#include "connectionmultiplexer.h"
-#include "multiplexchannel.h"
+#include "backends/multiplexer/connectionmultiplexer.h"
+#include "backends/multiplexer/multiplexchannel.h"
 
 BluetoothDownloadJob::BluetoothDownloadJob(ConnectionMultiplexer *connection, const QVariantMap &transferInfo, QObject *parent)
     : QObject(parent)
 {
-    QBluetoothUuid id{transferInfo.value(QStringLiteral("uuid")).toString()};
+    QUuid id{transferInfo.value(QStringLiteral("uuid")).toString()};
     mSocket = QSharedPointer<MultiplexChannel>{connection->getChannel(id).release()};
 }
 
@@ -5,11 +5,11 @@
  */
 
 #include "bluetoothlinkprovider.h"
+#include "backends/multiplexer/connectionmultiplexer.h"
+#include "backends/multiplexer/multiplexchannel.h"
 #include "bluetoothdevicelink.h"
-#include "connectionmultiplexer.h"
 #include "core_debug.h"
 #include "kdeconnectconfig.h"
-#include "multiplexchannel.h"
 
 #include <QBluetoothServiceInfo>
 
@@ -165,6 +165,7 @@ void BluetoothLinkProvider::clientConnected(QPointer<QBluetoothSocket> socket)
     }
 
     ConnectionMultiplexer *multiplexer = new ConnectionMultiplexer(socket, this);
+    connect(socket, &QBluetoothSocket::disconnected, multiplexer, &ConnectionMultiplexer::close);
 
     mSockets.insert(peer, multiplexer);
     disconnect(socket, nullptr, this, nullptr);
@@ -257,6 +258,7 @@ void BluetoothLinkProvider::serverNewConnection()
     }
 
     ConnectionMultiplexer *multiplexer = new ConnectionMultiplexer(socket, this);
+    connect(socket, &QBluetoothSocket::disconnected, multiplexer, &ConnectionMultiplexer::close);
 
     qCDebug(KDECONNECT_CORE) << socket->peerAddress() << "Multiplexer Instantiated";
 
@@ -6,8 +6,8 @@
  */
 
 #include "bluetoothuploadjob.h"
-#include "connectionmultiplexer.h"
-#include "multiplexchannel.h"
+#include "backends/multiplexer/connectionmultiplexer.h"
+#include "backends/multiplexer/multiplexchannel.h"
 
 #include "core_debug.h"
 #include <QBluetoothSocket>
@@ -10,10 +10,10 @@
 
 #include <QBluetoothAddress>
 #include <QBluetoothServer>
-#include <QBluetoothUuid>
 #include <QIODevice>
 #include <QSharedPointer>
 #include <QThread>
+#include <QUuid>
 #include <QVariantMap>
 
 class ConnectionMultiplexer;
@@ -30,7 +30,7 @@ public:
 
 private:
     QSharedPointer<QIODevice> mData;
-    QBluetoothUuid mTransferUuid;
+    QUuid mTransferUuid;
     QSharedPointer<MultiplexChannel> mSocket;
 
     void closeConnection();
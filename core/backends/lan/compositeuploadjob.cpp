@@ -5,17 +5,94 @@
  */
 
 #include "compositeuploadjob.h"
+#include "backends/multiplexer/multiplexchannel.h"
 #include "lanlinkprovider.h"
+#include "payloadhasher.h"
+#include "portallocator.h"
 #include "plugins/share/shareplugin.h"
 #include <KJobTrackerInterface>
 #include <KLocalizedString>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QUuid>
 #include <core_debug.h>
 #include <daemon.h>
 
+#include <algorithm>
+
+// Checksums of the files we sent are remembered for this many files, for when they are shared again
+static const int MAX_SENT_CONTENT_HASHES = 1000;
+
+static QString sentContentHashesPath()
+{
+    const QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    return cacheDir.absoluteFilePath(QStringLiteral("sent-content-hashes"));
+}
+
+// Identifies the file in @p packet by its path, size and modification time, empty if it's not worth remembering
+static QString contentHashKey(const NetworkPacket &packet)
+{
+    const QFile *file = qobject_cast<QFile *>(packet.payload().data());
+    if (!file || packet.payloadSize() < CompositeUploadJob::MIN_CONTENT_HASH_PAYLOAD_SIZE) {
+        return QString();
+    }
+    const QFileInfo fileInfo(file->fileName());
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fileInfo.absoluteFilePath().toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QByteArray::number(fileInfo.size()));
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+static QByteArray lookupContentHash(const QString &key)
+{
+    QSettings hashes(sentContentHashesPath(), QSettings::IniFormat);
+    const QByteArray contentHash = QByteArray::fromHex(hashes.value(key + QStringLiteral("/hash")).toString().toLatin1());
+    return contentHash.size() == PayloadHasher::HASH_SIZE ? contentHash : QByteArray();
+}
+
+static void storeContentHash(const QString &key, const QByteArray &contentHash)
+{
+    QSettings hashes(sentContentHashesPath(), QSettings::IniFormat);
+    hashes.beginGroup(key);
+    hashes.setValue(QStringLiteral("hash"), QString::fromLatin1(contentHash.toHex()));
+    hashes.setValue(QStringLiteral("updated"), QDateTime::currentSecsSinceEpoch());
+    hashes.endGroup();
+
+    const QStringList keys = hashes.childGroups();
+    if (keys.size() <= MAX_SENT_CONTENT_HASHES) {
+        return;
+    }
+    // Forget the files that were sent longest ago
+    QList<std::pair<qint64, QString>> byAge;
+    for (const QString &oldKey : keys) {
+        byAge.append({hashes.value(oldKey + QStringLiteral("/updated"), 0).toLongLong(), oldKey});
+    }
+    std::sort(byAge.begin(), byAge.end());
+    for (qsizetype i = 0; i < keys.size() - MAX_SENT_CONTENT_HASHES; i++) {
+        hashes.remove(byAge.at(i).second);
+    }
+}
+
 CompositeUploadJob::CompositeUploadJob(const QString &deviceId, bool displayNotification)
     : KCompositeJob()
     , m_server(new Server(this))
     , m_socket(nullptr)
+    , m_streamSocket(nullptr)
+    , m_payloadStreamEnabled(false)
+    , m_multiplexed(false)
+    , m_channelPriority(ConnectionMultiplexer::BulkPriority)
+    , m_parallelStreams(1)
+    , m_resumeEnabled(false)
+    , m_checksumEnabled(false)
+    , m_contentHashEnabled(false)
     , m_port(0)
     , m_deviceId(deviceId)
     , m_running(false)
@@ -35,6 +112,63 @@ CompositeUploadJob::CompositeUploadJob(const QString &deviceId, bool displayNoti
     }
 }
 
+CompositeUploadJob::~CompositeUploadJob()
+{
+    // m_server stops listening when it gets deleted along with us
+    if (m_port != 0) {
+        PortAllocator::release(m_port);
+    }
+}
+
+void CompositeUploadJob::setPayloadStreamEnabled(bool enabled)
+{
+    m_payloadStreamEnabled = enabled;
+    if (enabled && m_payloadStreamId.isEmpty()) {
+        m_payloadStreamId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    }
+}
+
+void CompositeUploadJob::setPayloadChannelPool(LanPayloadChannelPool *pool)
+{
+    m_channelPool = pool;
+}
+
+void CompositeUploadJob::setMultiplexer(ConnectionMultiplexer *multiplexer)
+{
+    m_multiplexer = multiplexer;
+    m_multiplexed = multiplexer != nullptr;
+}
+
+void CompositeUploadJob::setChannelPriority(ConnectionMultiplexer::ChannelPriority priority)
+{
+    m_channelPriority = priority;
+}
+
+void CompositeUploadJob::setParallelStreams(int streams)
+{
+    m_parallelStreams = qBound(1, streams, MAX_PARALLEL_STREAMS);
+}
+
+void CompositeUploadJob::setResumeEnabled(bool enabled)
+{
+    m_resumeEnabled = enabled;
+}
+
+void CompositeUploadJob::setChecksumEnabled(bool enabled)
+{
+    m_checksumEnabled = enabled;
+}
+
+void CompositeUploadJob::setContentHashEnabled(bool enabled)
+{
+    m_contentHashEnabled = enabled;
+}
+
+QVariantMap CompositeUploadJob::transferInfo()
+{
+    return m_transferInfo;
+}
+
 bool CompositeUploadJob::isRunning()
 {
     return m_running;
@@ -53,6 +187,13 @@ void CompositeUploadJob::start()
         return;
     }
 
+    if (m_multiplexed) {
+        m_running = true;
+        // Give SharePlugin some time to add subjobs
+        QMetaObject::invokeMethod(this, "startNextSubJob", Qt::QueuedConnection);
+        return;
+    }
+
     if (!startListening()) {
         return;
     }
@@ -61,23 +202,29 @@ void CompositeUploadJob::start()
 
     m_running = true;
 
+    if (m_payloadStreamEnabled && m_channelPool) {
+        // The receiver still has the stream of an earlier upload open, streamed payloads can go through it right away
+        m_streamSocket = m_channelPool->lease(&m_payloadStreamId);
+        if (m_streamSocket) {
+            m_streamSocket->setParent(this);
+            watchSocket(m_streamSocket);
+            m_timer.start();
+        }
+    }
+
     // Give SharePlugin some time to add subjobs
     QMetaObject::invokeMethod(this, "startNextSubJob", Qt::QueuedConnection);
 }
 
 bool CompositeUploadJob::startListening()
 {
-    m_port = MIN_PORT;
-    while (!m_server->listen(QHostAddress::Any, m_port)) {
-        m_port++;
-        if (m_port > MAX_PORT) { // No ports available?
-            qCWarning(KDECONNECT_CORE) << "CompositeUploadJob::startListening() - Error opening a port in range" << MIN_PORT << "-" << MAX_PORT;
-            m_port = 0;
-            setError(NoPortAvailable);
-            setErrorText(i18n("Couldn't find an available port"));
-            emitResult();
-            return false;
-        }
+    m_port = PortAllocator::listen(m_server, MIN_PORT, MAX_PORT);
+    if (m_port == 0) { // No ports available?
+        qCWarning(KDECONNECT_CORE) << "CompositeUploadJob::startListening() - Error opening a port in range" << MIN_PORT << "-" << MAX_PORT;
+        setError(NoPortAvailable);
+        setErrorText(i18n("Couldn't find an available port"));
+        emitResult();
+        return false;
     }
 
     qCDebug(KDECONNECT_CORE) << "CompositeUploadJob::startListening() - listening on port: " << m_port;
@@ -95,12 +242,66 @@ void CompositeUploadJob::startNextSubJob()
     // Already done by KCompositeJob
     // connect(m_currentJob, &KJob::result, this, &CompositeUploadJob::slotResult);
 
+    m_currentContentHash.clear();
+    m_currentContentHashKey.clear();
+    if (m_contentHashEnabled) {
+        // Only known if the file was sent before, it's not worth reading the whole file up front for a receiver that
+        // most likely doesn't have it. Sending it now remembers the checksum for the next time.
+        m_currentContentHashKey = contentHashKey(m_currentJob->getNetworkPacket());
+        if (!m_currentContentHashKey.isEmpty()) {
+            m_currentContentHash = lookupContentHash(m_currentContentHashKey);
+        }
+    }
+
+    sendCurrentPacket();
+}
+
+void CompositeUploadJob::sendCurrentPacket()
+{
+    if (!m_running) {
+        return;
+    }
+
     // TODO: Create a copy of the networkpacket that can be re-injected if sending via lan fails?
+    const int stripes = stripeCount(m_currentJob);
+    const bool resumable = stripes == 1 && isResumable(m_currentJob);
+    m_currentJob->setResumable(resumable);
+    m_currentJob->setStreamed(m_payloadStreamEnabled && !m_multiplexed && stripes == 1 && !resumable);
+    // Stripes are written out of order, there is no single stream of bytes to hash
+    m_currentJob->setChecksumEnabled(m_checksumEnabled && stripes == 1);
+
     NetworkPacket np = m_currentJob->getNetworkPacket();
     np.setPayload(nullptr, np.payloadSize());
-    np.setPayloadTransferInfo({{QStringLiteral("port"), m_port}});
+    // Opened before the packet goes out, so the receiver knows the channel by the time it reads the packet.
+    // The channel gets closed again if we bail out before handing it to the upload job.
+    std::unique_ptr<MultiplexChannel> channel;
+    if (m_multiplexed) {
+        if (m_multiplexer) {
+            const QUuid channelId = m_multiplexer->newChannel();
+            m_multiplexer->setChannelPriority(channelId, m_channelPriority);
+            channel = m_multiplexer->getChannel(channelId);
+            m_transferInfo = {{QStringLiteral("multiplexChannel"), channelId.toString(QUuid::WithoutBraces)}};
+        }
+    } else {
+        m_transferInfo = {{QStringLiteral("port"), m_port}};
+    }
+    if (stripes > 1) {
+        m_transferInfo.insert(QStringLiteral("parallelStreams"), stripes);
+        startStripes(stripes);
+    } else if (resumable) {
+        m_transferInfo.insert(QStringLiteral("resumable"), true);
+    } else if (m_currentJob->isStreamed()) {
+        m_transferInfo.insert(QStringLiteral("payloadStreamId"), m_payloadStreamId);
+    }
+    if (m_checksumEnabled && stripes == 1) {
+        m_transferInfo.insert(QStringLiteral("checksum"), PayloadHasher::algorithmName());
+    }
+    np.setPayloadTransferInfo(m_transferInfo);
     np.set<int>(QStringLiteral("numberOfFiles"), m_totalJobs);
     np.set<quint64>(QStringLiteral("totalPayloadSize"), m_totalPayloadSize);
+    if (!m_currentContentHash.isEmpty()) {
+        np.set<QString>(QStringLiteral("contentHash"), QString::fromLatin1(m_currentContentHash.toHex()));
+    }
 
     Device *device = Daemon::instance()->getDevice(m_deviceId);
     if (device == nullptr) {
@@ -108,8 +309,21 @@ void CompositeUploadJob::startNextSubJob()
         return;
     }
 
-    if (device->sendPacket(np)) {
-        m_server->resumeAccepting();
+    // Without its channel the payload can't be sent, which happens when the link was replaced since the upload started
+    if ((!m_multiplexed || channel) && device->sendPacket(np)) {
+        if (channel) {
+            if (!m_timer.isValid()) {
+                m_timer.start();
+            }
+            m_currentJob->setSocket(channel.release());
+            m_currentJob->start();
+        } else if (m_pendingStripes.isEmpty() && m_currentJob->isStreamed() && m_streamSocket && m_streamSocket->isEncrypted()) {
+            // The receiver reads this payload from the connection it already has open
+            m_currentJob->setSocket(m_streamSocket);
+            m_currentJob->start();
+        } else {
+            m_server->resumeAccepting();
+        }
     } else {
         setError(SendingNetworkPacketFailed);
         setErrorText(i18n("Failed to send packet to %1", device->name()));
@@ -122,20 +336,57 @@ void CompositeUploadJob::newConnection()
 {
     m_server->pauseAccepting();
 
-    m_socket = m_server->nextPendingConnection();
+    QSslSocket *socket = m_server->nextPendingConnection();
 
-    if (!m_socket) {
+    if (!socket) {
         qCDebug(KDECONNECT_CORE) << "CompositeUploadJob::newConnection() - m_server->nextPendingConnection() returned a nullptr";
         return;
     }
 
-    m_currentJob->setSocket(m_socket);
+    UploadJob *job = m_currentJob;
+    if (!m_pendingStripes.isEmpty()) {
+        // Each connection of a parallel transfer gets the next range, the stripe header tells the receiver which one
+        job = m_pendingStripes.takeFirst();
+        if (!m_pendingStripes.isEmpty()) {
+            m_server->resumeAccepting();
+        }
+    } else if (m_currentJob->isStreamed()) {
+        // Kept for the payloads that follow, the upload jobs only borrow it
+        if (m_streamSocket) {
+            m_streamSocket->deleteLater();
+        }
+        m_streamSocket = socket;
+        m_streamSocket->setParent(this);
+    } else {
+        m_socket = socket;
+    }
+
+    job->setSocket(socket);
+
+    watchSocket(socket);
+    connect(socket, &QSslSocket::encrypted, this, [this, job]() {
+        if (!m_timer.isValid()) {
+            m_timer.start();
+        }
+
+        job->start();
+    });
+
+    LanLinkProvider::configureSslSocket(socket, m_deviceId, true);
+
+    socket->startServerEncryption();
+}
 
-    connect(m_socket, &QSslSocket::disconnected, this, [this]() {
-        m_socket->close();
+void CompositeUploadJob::watchSocket(QSslSocket *socket)
+{
+    connect(socket, &QSslSocket::disconnected, this, [socket]() {
+        socket->close();
     });
-    connect(m_socket, &QAbstractSocket::errorOccurred, this, [this](QAbstractSocket::SocketError error) {
+    connect(socket, &QAbstractSocket::errorOccurred, this, [this](QAbstractSocket::SocketError error) {
         qCDebug(KDECONNECT_CORE) << "Error in socket occurred" << error;
+        if (!m_running) {
+            return;
+        }
         // Do not close the socket because when android closes the socket (share is cancelled) closing the socket leads to a cyclic socketError and eventually a
         // segv
         setError(SocketError);
@@ -143,25 +394,14 @@ void CompositeUploadJob::newConnection()
 
         m_running = false;
     });
-    connect(m_socket, &QSslSocket::sslErrors, this, [this](const QList<QSslError> &errors) {
+    connect(socket, &QSslSocket::sslErrors, this, [this, socket](const QList<QSslError> &errors) {
         qCDebug(KDECONNECT_CORE) << "Received ssl errors" << errors;
-        m_socket->close();
+        socket->close();
         setError(SslError);
         emitResult();
 
         m_running = false;
     });
-    connect(m_socket, &QSslSocket::encrypted, this, [this]() {
-        if (!m_timer.isValid()) {
-            m_timer.start();
-        }
-
-        m_currentJob->start();
-    });
-
-    LanLinkProvider::configureSslSocket(m_socket, m_deviceId, true);
-
-    m_socket->startServerEncryption();
 }
 
 bool CompositeUploadJob::addSubjob(KJob *job)
@@ -220,12 +460,110 @@ bool CompositeUploadJob::doKill()
     if (m_running) {
         m_running = false;
 
+        const QList<KJob *> stripes = m_stripes.keys();
+        for (KJob *stripe : stripes) {
+            qobject_cast<UploadJob *>(stripe)->stop();
+        }
         return m_currentJob->stop();
     }
 
     return true;
 }
 
+int CompositeUploadJob::stripeCount(UploadJob *job) const
+{
+    const NetworkPacket np = job->getNetworkPacket();
+    if (m_parallelStreams < 2 || m_multiplexed || np.payloadSize() < MIN_PARALLEL_PAYLOAD_SIZE) {
+        return 1;
+    }
+
+    // Every range is read through its own file handle
+    const QFile *file = qobject_cast<QFile *>(np.payload().data());
+    if (!file || file->fileName().isEmpty() || file->isSequential()) {
+        return 1;
+    }
+
+    return m_parallelStreams;
+}
+
+bool CompositeUploadJob::isResumable(UploadJob *job) const
+{
+    const NetworkPacket np = job->getNetworkPacket();
+    if (!m_resumeEnabled || np.payloadSize() < MIN_RESUMABLE_PAYLOAD_SIZE) {
+        return false;
+    }
+
+    const QFileDevice *file = qobject_cast<QFileDevice *>(np.payload().data());
+    return file && !file->isSequential();
+}
+
+void CompositeUploadJob::startStripes(int count)
+{
+    const NetworkPacket np = m_currentJob->getNetworkPacket();
+    const QString fileName = qobject_cast<QFile *>(np.payload().data())->fileName();
+    const qint64 size = np.payloadSize();
+
+    for (int i = 0; i < count; i++) {
+        const qint64 offset = size * i / count;
+        const qint64 end = size * (i + 1) / count;
+
+        NetworkPacket stripePacket = np;
+        stripePacket.setPayload(QSharedPointer<QFile>(new QFile(fileName)), size);
+
+        UploadJob *stripe = new UploadJob(stripePacket);
+        stripe->setParent(this);
+        stripe->setRange(offset, end - offset);
+        connect(stripe, &UploadJob::processedAmountChanged, this, &CompositeUploadJob::slotStripeProcessedAmount);
+        connect(stripe, &KJob::result, this, &CompositeUploadJob::slotStripeResult);
+
+        m_pendingStripes.append(stripe);
+        m_stripes.insert(stripe, 0);
+    }
+}
+
+void CompositeUploadJob::slotStripeProcessedAmount(KJob *job, KJob::Unit unit, qulonglong amount)
+{
+    m_stripes[job] = amount;
+
+    qulonglong total = 0;
+    for (qulonglong stripeAmount : std::as_const(m_stripes)) {
+        total += stripeAmount;
+    }
+    slotProcessedAmount(job, unit, total);
+}
+
+void CompositeUploadJob::slotStripeResult(KJob *job)
+{
+    m_stripes.remove(job);
+
+    if (error() || !m_running) {
+        return;
+    }
+
+    if (job->error()) {
+        setError(job->error());
+        setErrorText(job->errorText());
+        m_running = false;
+
+        const QList<KJob *> stripes = m_stripes.keys();
+        for (KJob *stripe : stripes) {
+            qobject_cast<UploadJob *>(stripe)->stop();
+        }
+        emitResult();
+        return;
+    }
+
+    if (!m_stripes.isEmpty()) {
+        return;
+    }
+
+    // The job that was split never ran, all of its data went through the stripes
+    m_currentJobSendPayloadSize = m_currentJob->getNetworkPacket().payloadSize();
+    removeSubjob(m_currentJob);
+    m_currentJob->deleteLater();
+    currentJobFinished();
+}
+
 void CompositeUploadJob::slotProcessedAmount(KJob * /*job*/, KJob::Unit unit, qulonglong amount)
 {
     m_currentJobSendPayloadSize = amount;
@@ -244,6 +582,14 @@ void CompositeUploadJob::slotProcessedAmount(KJob * /*job*/, KJob::Unit unit, qu
 
 void CompositeUploadJob::slotResult(KJob *job)
 {
+    UploadJob *uploadJob = qobject_cast<UploadJob *>(job);
+    if (!job->error() && uploadJob && !m_currentContentHashKey.isEmpty() && !uploadJob->checksum().isEmpty()) {
+        // Unless the file changed while it was being sent
+        if (contentHashKey(uploadJob->getNetworkPacket()) == m_currentContentHashKey) {
+            storeContentHash(m_currentContentHashKey, uploadJob->checksum());
+        }
+    }
+
     // Copies job error and errorText and emits result if job is in error otherwise removes job from subjob list
     KCompositeJob::slotResult(job);
 
@@ -251,12 +597,27 @@ void CompositeUploadJob::slotResult(KJob *job)
         return;
     }
 
+    currentJobFinished();
+}
+
+void CompositeUploadJob::currentJobFinished()
+{
     m_totalSendPayloadSize += m_currentJobSendPayloadSize;
 
     if (hasSubjobs()) {
         m_currentJobNum++;
         startNextSubJob();
     } else {
+        m_running = false;
+        if (m_streamSocket) {
+            if (m_channelPool) {
+                m_streamSocket->disconnect(this);
+                m_channelPool->release(m_streamSocket, m_payloadStreamId);
+            } else {
+                m_streamSocket->disconnectFromHost();
+            }
+            m_streamSocket = nullptr;
+        }
         emitResult();
     }
 }
@@ -7,10 +7,14 @@
 #ifndef COMPOSITEUPLOADJOB_H
 #define COMPOSITEUPLOADJOB_H
 
+#include "backends/multiplexer/connectionmultiplexer.h"
 #include "kdeconnectcore_export.h"
+#include "lanpayloadchannelpool.h"
 #include "server.h"
 #include "uploadjob.h"
 #include <KCompositeJob>
+#include <QHash>
+#include <QPointer>
 
 class KDECONNECTCORE_EXPORT CompositeUploadJob : public KCompositeJob
 {
@@ -18,15 +22,69 @@ class KDECONNECTCORE_EXPORT CompositeUploadJob : public KCompositeJob
 
 public:
     explicit CompositeUploadJob(const QString &deviceId, bool displayNotification);
+    ~CompositeUploadJob() override;
 
     void start() override;
     QVariantMap transferInfo();
     bool isRunning();
     bool addSubjob(KJob *job) override;
+    /**
+     * Send all payloads of known size over a single connection instead of opening one per file.
+     * Only enable this when the receiving device announced LINK_CAPABILITY_PAYLOAD_STREAM.
+     */
+    void setPayloadStreamEnabled(bool enabled);
+    /**
+     * Take the payload stream connection from @p pool if it has one, and give it back when done
+     */
+    void setPayloadChannelPool(LanPayloadChannelPool *pool);
+    /**
+     * Send every payload over a new channel of @p multiplexer instead of a payload connection.
+     * No port is opened then, and payload streams and parallel streams are not used.
+     * Only set this when the device link is multiplexed, see LINK_MULTIPLEXED_LINK_ALPN.
+     */
+    void setMultiplexer(ConnectionMultiplexer *multiplexer);
+    /**
+     * The priority class of the multiplexer channels the payloads are sent over, BulkPriority by default
+     */
+    void setChannelPriority(ConnectionMultiplexer::ChannelPriority priority);
+    /**
+     * Split large files in @p streams ranges that are sent over separate connections at the same time.
+     * Only use more than one stream when the receiving device announced LINK_CAPABILITY_PARALLEL_PAYLOAD.
+     */
+    void setParallelStreams(int streams);
+    /**
+     * Let the receiver continue large files from where an earlier attempt stopped.
+     * Only enable this when the receiving device announced LINK_CAPABILITY_PAYLOAD_RESUME.
+     */
+    void setResumeEnabled(bool enabled);
+    /**
+     * Follow every payload with a checksum the receiver can verify.
+     * Only enable this when the receiving device announced LINK_CAPABILITY_PAYLOAD_CHECKSUM.
+     */
+    void setChecksumEnabled(bool enabled);
+    /**
+     * Put the checksum of large files in the share packet, so the receiver can tell if it has the file already.
+     * Files aren't read ahead of sending them, the checksum is the one sent after the file the last time it was shared.
+     * Only enable this when the receiving device announced LINK_CAPABILITY_CONTENT_HASH.
+     */
+    void setContentHashEnabled(bool enabled);
+
+    constexpr static qint64 MIN_PARALLEL_PAYLOAD_SIZE = 16 * 1024 * 1024;
+    constexpr static int MAX_PARALLEL_STREAMS = 8;
+    // Smaller files are cheaper to send again than to give up the shared payload stream for
+    constexpr static qint64 MIN_RESUMABLE_PAYLOAD_SIZE = 8 * 1024 * 1024;
+    // Receivers can only skip payloads they get to ask for, so only the checksums of resumable files are worth remembering
+    constexpr static qint64 MIN_CONTENT_HASH_PAYLOAD_SIZE = MIN_RESUMABLE_PAYLOAD_SIZE;
 
 private:
     bool startListening();
     void emitDescription(const QString &currentFileName);
+    int stripeCount(UploadJob *job) const;
+    bool isResumable(UploadJob *job) const;
+    void sendCurrentPacket();
+    void startStripes(int count);
+    void currentJobFinished();
+    void watchSocket(QSslSocket *socket);
 
 protected:
     bool doKill() override;
@@ -36,6 +94,25 @@ private:
 
     Server *const m_server;
     QSslSocket *m_socket;
+    QSslSocket *m_streamSocket;
+    QString m_payloadStreamId;
+    bool m_payloadStreamEnabled;
+    QPointer<LanPayloadChannelPool> m_channelPool;
+    // The multiplexer goes away with its device link, m_multiplexed remembers that we were using one
+    QPointer<ConnectionMultiplexer> m_multiplexer;
+    bool m_multiplexed;
+    ConnectionMultiplexer::ChannelPriority m_channelPriority;
+    int m_parallelStreams;
+    bool m_resumeEnabled;
+    bool m_checksumEnabled;
+    bool m_contentHashEnabled;
+    QByteArray m_currentContentHash;
+    // Where the checksum of the current file goes once it was sent, empty if it's not worth remembering
+    QString m_currentContentHashKey;
+    // Ranges of the current file still waiting for their connection, and all that haven't finished yet
+    QList<UploadJob *> m_pendingStripes;
+    QHash<KJob *, qulonglong> m_stripes;
+    QVariantMap m_transferInfo;
     quint16 m_port;
     QString m_deviceId;
     bool m_running;
@@ -56,6 +133,8 @@ private Q_SLOTS:
     void newConnection();
     void slotProcessedAmount(KJob *job, KJob::Unit unit, qulonglong amount);
     void slotResult(KJob *job) override;
+    void slotStripeProcessedAmount(KJob *job, KJob::Unit unit, qulonglong amount);
+    void slotStripeResult(KJob *job);
     void startNextSubJob();
     void sendUpdatePacket();
 };
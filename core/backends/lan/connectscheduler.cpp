@@ -0,0 +1,169 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "connectscheduler.h"
+#include "core_debug.h"
+
+#include <QRandomGenerator>
+#include <QTimer>
+
+static const qint64 MILLIS_FIRST_BACKOFF = 1000;
+static const qint64 MILLIS_MAX_BACKOFF = 64000;
+// Beyond this, backoffs that ran out are dropped
+static const int MAX_BACKOFFS = 1024;
+
+enum Queue {
+    TrustedQueue,
+    UnknownQueue,
+};
+
+ConnectScheduler::ConnectScheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+}
+
+bool ConnectScheduler::schedule(const QString &deviceId, const QHostAddress &address, bool isDeviceTrusted, const StartFunction &start)
+{
+    const QString peer = peerKey(deviceId, address);
+    const auto backoff = m_backoffs.constFind(peer);
+    if (backoff != m_backoffs.cend() && backoff->retryAt > m_clock.elapsed()) {
+        return false;
+    }
+    if (hasAttempt(peer)) {
+        return false;
+    }
+
+    if (m_queues[TrustedQueue].size() + m_queues[UnknownQueue].size() >= MAX_QUEUED_CONNECTS) {
+        if (!isDeviceTrusted || m_queues[UnknownQueue].isEmpty()) {
+            return false;
+        }
+        // Make room by dropping the newest unknown device
+        m_queues[UnknownQueue].removeLast();
+    }
+
+    m_queues[isDeviceTrusted ? TrustedQueue : UnknownQueue].append(Attempt{peer, start});
+    startQueued();
+    return true;
+}
+
+void ConnectScheduler::clear()
+{
+    m_queues[TrustedQueue].clear();
+    m_queues[UnknownQueue].clear();
+}
+
+QString ConnectScheduler::peerKey(const QString &deviceId, const QHostAddress &address)
+{
+    // Keyed by address too, so a spoofed identity pointing somewhere unreachable doesn't hold back the real device
+    return deviceId + QLatin1Char('@') + address.toString();
+}
+
+bool ConnectScheduler::hasAttempt(const QString &peer) const
+{
+    for (const QList<Attempt> &queue : m_queues) {
+        for (const Attempt &attempt : queue) {
+            if (attempt.peer == peer) {
+                return true;
+            }
+        }
+    }
+    for (const QString &running : m_running) {
+        if (running == peer) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ConnectScheduler::startQueued()
+{
+    while (m_running.size() < MAX_CONCURRENT_CONNECTS) {
+        QList<Attempt> &queue = m_queues[TrustedQueue].isEmpty() ? m_queues[UnknownQueue] : m_queues[TrustedQueue];
+        if (queue.isEmpty()) {
+            return;
+        }
+        const Attempt attempt = queue.takeFirst();
+        QSslSocket *socket = attempt.start();
+        if (!socket) {
+            continue;
+        }
+
+        m_running.insert(socket, attempt.peer);
+        // The attempt is over once the handshake is done, or the socket fails or goes away before that
+        connect(socket, &QSslSocket::encrypted, this, [this, socket]() {
+            finished(socket, true);
+        });
+        connect(socket, &QAbstractSocket::errorOccurred, this, [this, socket]() {
+            finished(socket, false);
+        });
+        connect(socket, &QObject::destroyed, this, [this, socket]() {
+            finished(socket, false);
+        });
+        // Goes away with the socket, and does nothing if the attempt ended in time
+        QTimer::singleShot(MILLIS_ATTEMPT_DEADLINE, socket, [this, socket]() {
+            if (m_running.contains(socket)) {
+                qCDebug(KDECONNECT_CORE) << "Connection attempt to" << m_running.value(socket) << "timed out";
+                finished(socket, false);
+                socket->abort();
+                socket->deleteLater();
+            }
+        });
+    }
+}
+
+void ConnectScheduler::cancel(QSslSocket *socket)
+{
+    QString peer;
+    if (release(socket, &peer)) {
+        startQueued();
+    }
+}
+
+bool ConnectScheduler::release(QSslSocket *socket, QString *peer)
+{
+    const auto running = m_running.constFind(socket);
+    if (running == m_running.cend()) {
+        return false;
+    }
+    *peer = running.value();
+    m_running.erase(running);
+    disconnect(socket, nullptr, this, nullptr);
+    return true;
+}
+
+void ConnectScheduler::finished(QSslSocket *socket, bool success)
+{
+    QString peer;
+    if (!release(socket, &peer)) {
+        return;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    if (success) {
+        m_backoffs.remove(peer);
+    } else {
+        if (m_backoffs.size() >= MAX_BACKOFFS) {
+            prune(now);
+        }
+        Backoff &backoff = m_backoffs[peer];
+        backoff.failures++;
+        // Jittered by ±25% so devices that failed together don't all retry together
+        const qint64 delay = qMin(MILLIS_FIRST_BACKOFF << qMin(backoff.failures - 1, 16), MILLIS_MAX_BACKOFF);
+        backoff.retryAt = now + delay * 3 / 4 + QRandomGenerator::global()->bounded(delay / 2 + 1);
+    }
+
+    startQueued();
+}
+
+void ConnectScheduler::prune(qint64 now)
+{
+    m_backoffs.removeIf([now](const QHash<QString, Backoff>::iterator &it) {
+        return it->retryAt <= now;
+    });
+}
+
+#include "moc_connectscheduler.cpp"
@@ -0,0 +1,87 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef CONNECTSCHEDULER_H
+#define CONNECTSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QSslSocket>
+#include <functional>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * Decides when outgoing connection attempts to other devices start.
+ *
+ * Only a few attempts run at once (from the TCP connect until the TLS handshake is done or failed), the rest wait in
+ * a queue where trusted devices go before unknown ones. A peer (a device id at an address) whose attempt failed is
+ * turned away for a while, twice as long after every further failure. An attempt that takes longer than
+ * MILLIS_ATTEMPT_DEADLINE is aborted, its socket deleted, and counted as a failure.
+ */
+class KDECONNECTCORE_EXPORT ConnectScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Creates the socket and starts connecting it. May return nullptr if the attempt isn't needed anymore.
+     */
+    using StartFunction = std::function<QSslSocket *()>;
+
+    // Each attempt holds a socket and ends in a TLS handshake, starting all of them at once on a busy network spikes both
+    const static int MAX_CONCURRENT_CONNECTS = 8;
+    const static int MAX_QUEUED_CONNECTS = 64;
+    // Unanswered connects only time out after minutes, and a peer could stall the handshake forever
+    const static int MILLIS_ATTEMPT_DEADLINE = 5000;
+
+    explicit ConnectScheduler(QObject *parent = nullptr);
+
+    /**
+     * Queues an attempt to connect to @p deviceId at @p address, @p start is called once it's its turn.
+     * Returns false if the attempt was dropped: the peer is backing off, already has an attempt, or the queue is full.
+     */
+    bool schedule(const QString &deviceId, const QHostAddress &address, bool isDeviceTrusted, const StartFunction &start);
+
+    /**
+     * Ends the attempt of @p socket without counting it as a failure, e.g. because another attempt to the same device
+     * won. The socket is left to the caller.
+     */
+    void cancel(QSslSocket *socket);
+
+    /**
+     * Drops the attempts that haven't started yet
+     */
+    void clear();
+
+private:
+    struct Attempt {
+        QString peer;
+        StartFunction start;
+    };
+    struct Backoff {
+        int failures = 0;
+        qint64 retryAt = 0;
+    };
+
+    static QString peerKey(const QString &deviceId, const QHostAddress &address);
+    bool hasAttempt(const QString &peer) const;
+    void startQueued();
+    bool release(QSslSocket *socket, QString *peer);
+    void finished(QSslSocket *socket, bool success);
+    void prune(qint64 now);
+
+    // Trusted devices first, then unknown ones
+    QList<Attempt> m_queues[2];
+    QHash<QSslSocket *, QString> m_running;
+    QHash<QString, Backoff> m_backoffs;
+    QElapsedTimer m_clock;
+};
+
+#endif // CONNECTSCHEDULER_H
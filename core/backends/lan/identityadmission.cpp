@@ -0,0 +1,96 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "identityadmission.h"
+
+#include <QByteArrayView>
+
+IdentityAdmission::IdentityAdmission()
+{
+    m_clock.start();
+}
+
+QByteArray IdentityAdmission::peekDeviceId(const QByteArray &datagram)
+{
+    static const QByteArray key = QByteArrayLiteral("\"deviceId\"");
+    qsizetype pos = datagram.indexOf(key);
+    if (pos < 0) {
+        return {};
+    }
+    pos += key.size();
+
+    // The value follows after a colon, possibly surrounded by whitespace
+    const auto skipWhitespace = [&datagram, &pos]() {
+        while (pos < datagram.size() && (datagram[pos] == ' ' || datagram[pos] == '\t' || datagram[pos] == '\n' || datagram[pos] == '\r')) {
+            pos++;
+        }
+    };
+    skipWhitespace();
+    if (pos >= datagram.size() || datagram[pos] != ':') {
+        return {};
+    }
+    pos++;
+    skipWhitespace();
+    if (pos >= datagram.size() || datagram[pos] != '"') {
+        return {};
+    }
+    pos++;
+
+    const qsizetype end = datagram.indexOf('"', pos);
+    if (end < 0 || end - pos > MAX_DEVICE_ID_LENGTH) {
+        return {};
+    }
+    const QByteArrayView value = QByteArrayView(datagram).sliced(pos, end - pos);
+    if (value.isEmpty() || value.contains('\\')) {
+        // Escape sequences are left to the JSON parser
+        return {};
+    }
+    return value.toByteArray();
+}
+
+bool IdentityAdmission::admit(const QByteArray &deviceId, const QByteArray &datagram)
+{
+    const qint64 now = m_clock.elapsed();
+    const size_t datagramHash = qHash(datagram);
+
+    auto it = m_buckets.find(deviceId);
+    if (it == m_buckets.end()) {
+        if (m_buckets.size() >= MAX_BUCKETS) {
+            prune(now);
+            if (m_buckets.size() >= MAX_BUCKETS) {
+                return false;
+            }
+        }
+        it = m_buckets.insert(deviceId, Bucket{now, BUCKET_CAPACITY, 0, -MILLIS_DUPLICATE_WINDOW});
+    }
+    Bucket &bucket = it.value();
+
+    if (bucket.lastDatagramHash == datagramHash && now - bucket.lastDatagramAt < MILLIS_DUPLICATE_WINDOW) {
+        return false;
+    }
+
+    const qint64 refill = (now - bucket.refilledAt) / MILLIS_PER_TOKEN;
+    if (refill > 0) {
+        bucket.tokens = qMin<qint64>(BUCKET_CAPACITY, bucket.tokens + refill);
+        bucket.refilledAt += refill * MILLIS_PER_TOKEN;
+    }
+    if (bucket.tokens == 0) {
+        return false;
+    }
+    bucket.tokens--;
+    bucket.lastDatagramHash = datagramHash;
+    bucket.lastDatagramAt = now;
+    return true;
+}
+
+void IdentityAdmission::prune(qint64 now)
+{
+    // A bucket that would be full again holds nothing a fresh one wouldn't
+    m_buckets.removeIf([now](const QHash<QByteArray, Bucket>::iterator &it) {
+        const Bucket &bucket = it.value();
+        return bucket.tokens + (now - bucket.refilledAt) / MILLIS_PER_TOKEN >= BUCKET_CAPACITY && now - bucket.lastDatagramAt >= MILLIS_DUPLICATE_WINDOW;
+    });
+}
@@ -0,0 +1,61 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef IDENTITYADMISSION_H
+#define IDENTITYADMISSION_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * Decides which UDP identity packets are worth parsing and answering with a connection.
+ *
+ * Every device id gets a token bucket: a device may make a couple of connection attempts in a row, and one more
+ * per second after that. Repeats of the very datagram that was just admitted are dropped without using a token.
+ */
+class KDECONNECTCORE_EXPORT IdentityAdmission
+{
+public:
+    constexpr static int BUCKET_CAPACITY = 2;
+    constexpr static qint64 MILLIS_PER_TOKEN = 1000;
+    // The same datagram arriving again within this time is a copy (several interfaces, broadcast and unicast), not a retry
+    constexpr static qint64 MILLIS_DUPLICATE_WINDOW = 500;
+    // Beyond this, unknown devices are turned away until idle buckets can be dropped
+    constexpr static int MAX_BUCKETS = 1024;
+    // Device ids are UUIDs with underscores, anything much longer isn't worth looking up
+    constexpr static int MAX_DEVICE_ID_LENGTH = 64;
+
+    IdentityAdmission();
+
+    /**
+     * Finds the device id in a serialized identity packet without parsing all of it.
+     * Returns an empty array if it isn't a plain string value, the full parse has to find the id then.
+     */
+    static QByteArray peekDeviceId(const QByteArray &datagram);
+
+    /**
+     * Takes a token from the bucket of @p deviceId.
+     * Returns false if @p datagram is a duplicate or the device ran out of tokens.
+     */
+    bool admit(const QByteArray &deviceId, const QByteArray &datagram);
+
+private:
+    struct Bucket {
+        qint64 refilledAt;
+        int tokens;
+        size_t lastDatagramHash;
+        qint64 lastDatagramAt;
+    };
+    void prune(qint64 now);
+
+    QHash<QByteArray, Bucket> m_buckets;
+    QElapsedTimer m_clock;
+};
+
+#endif // IDENTITYADMISSION_H
@@ -7,33 +7,80 @@
 #include "landevicelink.h"
 
 #include <KLocalizedString>
+#include <QtEndian>
 
 #include "backends/linkprovider.h"
+#include "backends/multiplexer/multiplexchannel.h"
 #include "core_debug.h"
 #include "kdeconnectconfig.h"
 #include "lanlinkprovider.h"
+#include "lanstripedpayload.h"
+#include "linkcapabilities.h"
 #include "plugins/share/shareplugin.h"
 
 LanDeviceLink::LanDeviceLink(const DeviceInfo &deviceInfo, LanLinkProvider *parent, QSslSocket *socket)
     : DeviceLink(deviceInfo.id, parent)
     , m_socket(nullptr)
+    , m_multiplexer(nullptr)
+    , m_packetChannel(nullptr)
+    , m_payloadChannels(new LanPayloadChannelPool(this))
     , m_deviceInfo(deviceInfo)
 {
-    reset(socket);
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LanDeviceLink::flushSendQueue);
+
+    reset(socket, deviceInfo);
+}
+
+LanDeviceLink::~LanDeviceLink()
+{
+    // The multiplexer closes the socket when it goes away, so it can't outlive it
+    disconnect(m_socket, &QAbstractSocket::disconnected, this, &QObject::deleteLater);
+    closeMultiplexer();
 }
 
-void LanDeviceLink::reset(QSslSocket *socket)
+void LanDeviceLink::reset(QSslSocket *socket, const DeviceInfo &deviceInfo)
 {
     if (m_socket) {
         disconnect(m_socket, &QAbstractSocket::disconnected, this, &QObject::deleteLater);
+        closeMultiplexer();
         delete m_socket;
+        // Encoded for the old connection, which may not have used the same one
+        m_sendQueue.clear();
+        m_flushTimer.stop();
     }
 
+    // The framing, packet encoding and payload transfers below all follow what the peer announced on this connection
+    m_deviceInfo = deviceInfo;
+
     m_socket = socket;
     socket->setParent(this);
+    m_receiveBuffer.clear();
 
     connect(socket, &QAbstractSocket::disconnected, this, &QObject::deleteLater);
-    connect(socket, &QAbstractSocket::readyRead, this, &LanDeviceLink::dataReceived);
+
+    // Both ends agreed on it in the TLS handshake, and switch before anything else is sent on the new connection
+    if (socket->sslConfiguration().nextNegotiatedProtocol() == LINK_MULTIPLEXED_LINK_ALPN) {
+        m_multiplexer = new ConnectionMultiplexer(socket, this, MULTIPLEX_CHANNEL_BUFFER_SIZE);
+        MultiplexChannel *channel = m_multiplexer->getDefaultChannel().release();
+        channel->setParent(this);
+        m_packetChannel = channel;
+    } else {
+        m_packetChannel = socket;
+    }
+    connect(m_packetChannel, &QIODevice::readyRead, this, &LanDeviceLink::dataReceived);
+}
+
+void LanDeviceLink::closeMultiplexer()
+{
+    if (!m_multiplexer) {
+        return;
+    }
+    delete m_packetChannel;
+    m_packetChannel = nullptr;
+    delete m_multiplexer;
+    m_multiplexer = nullptr;
 }
 
 QHostAddress LanDeviceLink::hostAddress() const
@@ -53,12 +100,26 @@ QHostAddress LanDeviceLink::hostAddress() const
     return addr;
 }
 
+bool LanDeviceLink::isConnected() const
+{
+    return m_socket && m_socket->state() == QAbstractSocket::ConnectedState;
+}
+
 bool LanDeviceLink::sendPacket(NetworkPacket &np)
 {
     if (np.payload()) {
         if (np.type() == PACKET_TYPE_SHARE_REQUEST && np.payloadSize() >= 0) {
             if (!m_compositeUploadJob || !m_compositeUploadJob->isRunning()) {
                 m_compositeUploadJob = new CompositeUploadJob(deviceId(), true);
+                m_compositeUploadJob->setMultiplexer(m_multiplexer);
+                m_compositeUploadJob->setPayloadStreamEnabled(m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_PAYLOAD_STREAM));
+                m_compositeUploadJob->setPayloadChannelPool(m_payloadChannels);
+                m_compositeUploadJob->setResumeEnabled(m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_PAYLOAD_RESUME));
+                m_compositeUploadJob->setChecksumEnabled(m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_PAYLOAD_CHECKSUM));
+                m_compositeUploadJob->setContentHashEnabled(m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_CONTENT_HASH));
+                if (m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_PARALLEL_PAYLOAD)) {
+                    m_compositeUploadJob->setParallelStreams(KdeConnectConfig::instance().parallelPayloadStreams());
+                }
             }
 
             m_compositeUploadJob->addSubjob(new UploadJob(np));
@@ -66,52 +127,180 @@ bool LanDeviceLink::sendPacket(NetworkPacket &np)
             if (!m_compositeUploadJob->isRunning()) {
                 m_compositeUploadJob->start();
             }
-        } else { // Infinite stream
+        } else {
             CompositeUploadJob *fireAndForgetJob = new CompositeUploadJob(deviceId(), false);
+            fireAndForgetJob->setMultiplexer(m_multiplexer);
+            if (np.payloadSize() >= 0) {
+                // Icons, album art and the like are small, the connection setup would take longer than sending them
+                fireAndForgetJob->setPayloadStreamEnabled(m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_PAYLOAD_STREAM));
+                fireAndForgetJob->setPayloadChannelPool(m_payloadChannels);
+                if (np.payloadSize() <= MAX_INTERACTIVE_PAYLOAD_SIZE) {
+                    // Someone is looking at the notification the icon belongs to, a large share can wait a moment
+                    fireAndForgetJob->setChannelPriority(ConnectionMultiplexer::InteractivePriority);
+                }
+            }
             fireAndForgetJob->addSubjob(new UploadJob(np));
             fireAndForgetJob->start();
         }
 
         return true;
     } else {
-        int written = m_socket->write(np.serialize());
+        QByteArray serializedPacket;
+        if (m_deviceInfo.linkCapabilities.contains(LINK_CAPABILITY_CBOR_PACKETS)) {
+            serializedPacket = np.serializeCbor();
+        }
+        if (!serializedPacket.isEmpty() && serializedPacket.size() <= MAX_CBOR_PACKET_SIZE) {
+            char header[CBOR_FRAME_HEADER_SIZE];
+            qToBigEndian<quint32>(serializedPacket.size(), header);
+            serializedPacket.prepend(header, CBOR_FRAME_HEADER_SIZE);
+        } else {
+            serializedPacket = np.serialize();
+        }
+        if (!m_packetChannel->isWritable()) {
+            return false;
+        }
+
+        // Every write becomes at least one TLS record, so bursts of small packets are queued and written at once
+        m_sendQueue += serializedPacket;
+        if (isLatencySensitive(np) || m_sendQueue.size() >= SEND_QUEUE_FLUSH_SIZE) {
+            flushSendQueue();
+        } else if (!m_flushTimer.isActive()) {
+            m_flushTimer.start();
+        }
 
         // Actually we can't detect if a packet is received or not. We keep TCP
         //"ESTABLISHED" connections that look legit (return true when we use them),
         // but that are actually broken (until keepalive detects that they are down).
-        return (written != -1);
+        return true;
+    }
+}
+
+bool LanDeviceLink::isLatencySensitive(const NetworkPacket &np)
+{
+    // Input events are felt right away when they lag behind
+    return np.type().startsWith(QLatin1String("kdeconnect.mousepad.")) || np.type() == QLatin1String("kdeconnect.presenter");
+}
+
+void LanDeviceLink::flushSendQueue()
+{
+    m_flushTimer.stop();
+    if (m_sendQueue.isEmpty()) {
+        return;
+    }
+
+    if (m_packetChannel->write(m_sendQueue) == -1) {
+        qCWarning(KDECONNECT_CORE) << "Could not write" << m_sendQueue.size() << "bytes to" << deviceId() << m_packetChannel->errorString();
     }
+    m_sendQueue.clear();
 }
 
 void LanDeviceLink::dataReceived()
 {
-    while (m_socket->canReadLine()) {
-        const QByteArray serializedPacket = m_socket->readLine();
+    while (true) {
         NetworkPacket packet;
-        NetworkPacket::unserialize(serializedPacket, &packet);
-
-        // qCDebug(KDECONNECT_CORE) << "LanDeviceLink dataReceived" << serializedPacket;
+        if (!readPacket(&packet)) {
+            break;
+        }
 
         if (packet.hasPayloadTransferInfo()) {
             // qCDebug(KDECONNECT_CORE) << "HasPayloadTransferInfo";
             const QVariantMap transferInfo = packet.payloadTransferInfo();
+            const quint16 port = transferInfo[QStringLiteral("port")].toInt();
+            const QString streamId = transferInfo[QStringLiteral("payloadStreamId")].toString();
+            const int parallelStreams = qBound(1, transferInfo[QStringLiteral("parallelStreams")].toInt(), CompositeUploadJob::MAX_PARALLEL_STREAMS);
+            const QString multiplexChannel = transferInfo[QStringLiteral("multiplexChannel")].toString();
 
-            QSharedPointer<QSslSocket> socket(new QSslSocket);
+            if (!multiplexChannel.isEmpty()) {
+                std::unique_ptr<MultiplexChannel> channel;
+                if (m_multiplexer) {
+                    channel = m_multiplexer->getChannel(QUuid(multiplexChannel));
+                }
+                if (channel) {
+                    packet.setPayload(QSharedPointer<QIODevice>(channel.release()), packet.payloadSize());
+                } else {
+                    qCWarning(KDECONNECT_CORE) << "Payload of" << packet.type() << "refers to unknown channel" << multiplexChannel;
+                }
+            } else if (parallelStreams > 1 && packet.payloadSize() >= 0) {
+                QList<QSslSocket *> sockets;
+                for (int i = 0; i < parallelStreams; i++) {
+                    sockets.append(createPayloadSocket(port));
+                }
+                packet.setPayload(QSharedPointer<QIODevice>(new LanStripedPayload(sockets, packet.payloadSize())), packet.payloadSize());
+            } else if (!streamId.isEmpty() && packet.payloadSize() >= 0) {
+                packet.setPayload(streamedPayload(streamId, port), packet.payloadSize());
+            } else {
+                packet.setPayload(QSharedPointer<QSslSocket>(createPayloadSocket(port)), packet.payloadSize());
+            }
+        }
 
-            LanLinkProvider::configureSslSocket(socket.data(), deviceId(), true);
+        Q_EMIT receivedPacket(packet);
+    }
+}
 
-            // emit readChannelFinished when the socket gets disconnected. This seems to be a bug in upstream QSslSocket.
-            // Needs investigation and upstreaming of the fix. QTBUG-62257
-            connect(socket.data(), &QAbstractSocket::disconnected, socket.data(), &QAbstractSocket::readChannelFinished);
+bool LanDeviceLink::readPacket(NetworkPacket *packet)
+{
+    // A multiplexed channel only lets the sender fill its read window, so incomplete packets can't be left in the device
+    m_receiveBuffer += m_packetChannel->readAll();
 
-            const QString address = m_socket->peerAddress().toString();
-            const quint16 port = transferInfo[QStringLiteral("port")].toInt();
-            socket->connectToHostEncrypted(address, port, QIODevice::ReadWrite);
-            packet.setPayload(socket, packet.payloadSize());
+    while (!m_receiveBuffer.isEmpty()) {
+        bool unserialized;
+        if (m_receiveBuffer.at(0) != 0) {
+            const qsizetype lineEnd = m_receiveBuffer.indexOf('\n');
+            if (lineEnd < 0) {
+                return false;
+            }
+            const QByteArray serializedPacket = m_receiveBuffer.left(lineEnd + 1);
+            m_receiveBuffer.remove(0, lineEnd + 1);
+            // qCDebug(KDECONNECT_CORE) << "LanDeviceLink dataReceived" << serializedPacket;
+            unserialized = NetworkPacket::unserialize(serializedPacket, packet);
+        } else {
+            if (m_receiveBuffer.size() < CBOR_FRAME_HEADER_SIZE) {
+                return false;
+            }
+            const qint64 size = qFromBigEndian<quint32>(m_receiveBuffer.constData());
+            if (m_receiveBuffer.size() < CBOR_FRAME_HEADER_SIZE + size) {
+                return false;
+            }
+            unserialized = NetworkPacket::unserializeCbor(m_receiveBuffer.mid(CBOR_FRAME_HEADER_SIZE, size), packet);
+            m_receiveBuffer.remove(0, CBOR_FRAME_HEADER_SIZE + size);
         }
 
-        Q_EMIT receivedPacket(packet);
+        if (unserialized) {
+            return true;
+        }
+        // The framing is still intact, so only this packet is lost
+        qCWarning(KDECONNECT_CORE) << "Dropping a malformed packet from" << deviceId();
+    }
+    return false;
+}
+
+QSslSocket *LanDeviceLink::createPayloadSocket(quint16 port)
+{
+    QSslSocket *socket = new QSslSocket;
+
+    LanLinkProvider::configureSslSocket(socket, deviceId(), true);
+
+    // emit readChannelFinished when the socket gets disconnected. This seems to be a bug in upstream QSslSocket.
+    // Needs investigation and upstreaming of the fix. QTBUG-62257
+    connect(socket, &QAbstractSocket::disconnected, socket, &QAbstractSocket::readChannelFinished);
+
+    const QString address = m_socket->peerAddress().toString();
+    socket->connectToHostEncrypted(address, port, QIODevice::ReadWrite);
+    return socket;
+}
+
+QSharedPointer<QIODevice> LanDeviceLink::streamedPayload(const QString &streamId, quint16 port)
+{
+    // Every file of a share travels over the same connection, only the first one opens it
+    QPointer<LanPayloadStream> stream = m_payloadStreams.value(streamId);
+    if (!stream) {
+        stream = new LanPayloadStream(createPayloadSocket(port), this);
+        m_payloadStreams.insert(streamId, stream);
+        connect(stream, &QObject::destroyed, this, [this, streamId]() {
+            m_payloadStreams.remove(streamId);
+        });
     }
+    return stream->nextPayload();
 }
 
 #include "moc_landevicelink.cpp"
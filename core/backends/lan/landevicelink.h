@@ -7,14 +7,19 @@
 #ifndef LANDEVICELINK_H
 #define LANDEVICELINK_H
 
+#include <QHash>
 #include <QObject>
 #include <QPointer>
 #include <QSslSocket>
 #include <QString>
+#include <QTimer>
 
 #include "backends/devicelink.h"
+#include "backends/multiplexer/connectionmultiplexer.h"
 #include "compositeuploadjob.h"
 #include "deviceinfo.h"
+#include "lanpayloadchannelpool.h"
+#include "lanpayloadstream.h"
 #include "uploadjob.h"
 #include <kdeconnectcore_export.h>
 
@@ -26,7 +31,12 @@ class KDECONNECTCORE_EXPORT LanDeviceLink : public DeviceLink
 
 public:
     LanDeviceLink(const DeviceInfo &deviceInfo, LanLinkProvider *parent, QSslSocket *socket);
-    void reset(QSslSocket *socket);
+    ~LanDeviceLink() override;
+    /**
+     * Replaces the connection. @p deviceInfo comes from the identity received on the new one, the peer may have
+     * changed its capabilities since.
+     */
+    void reset(QSslSocket *socket, const DeviceInfo &deviceInfo);
 
     bool sendPacket(NetworkPacket &np) override;
 
@@ -36,13 +46,42 @@ public:
     }
 
     QHostAddress hostAddress() const;
+    bool isConnected() const;
+
+    // CBOR packets are prefixed with their size as a big endian quint32. JSON packets never start with a zero byte,
+    // so keeping the size below 2^24 lets both kinds be told apart by their first byte.
+    constexpr static int CBOR_FRAME_HEADER_SIZE = 4;
+    constexpr static qint64 MAX_CBOR_PACKET_SIZE = 0xFFFFFF;
+
+    // Packets sent in the same event loop iteration are written together, up to the size of a TLS record
+    constexpr static qint64 SEND_QUEUE_FLUSH_SIZE = 16 * 1024;
+
+    // Read window of every channel when the link is multiplexed, enough to keep a LAN busy between two read requests
+    constexpr static int MULTIPLEX_CHANNEL_BUFFER_SIZE = 1024 * 1024;
+    // Payloads of other packets than shares up to this size go ahead of share uploads on a multiplexed link
+    constexpr static qint64 MAX_INTERACTIVE_PAYLOAD_SIZE = 1024 * 1024;
 
 private Q_SLOTS:
     void dataReceived();
+    void flushSendQueue();
 
 private:
+    bool readPacket(NetworkPacket *packet);
+    void closeMultiplexer();
+    static bool isLatencySensitive(const NetworkPacket &np);
+    QSslSocket *createPayloadSocket(quint16 port);
+    QSharedPointer<QIODevice> streamedPayload(const QString &streamId, quint16 port);
+
     QSslSocket *m_socket;
+    // Packets are read from and written to m_socket, or its default channel when the link is multiplexed
+    ConnectionMultiplexer *m_multiplexer;
+    QIODevice *m_packetChannel;
+    QByteArray m_receiveBuffer;
+    QByteArray m_sendQueue;
+    QTimer m_flushTimer;
     QPointer<CompositeUploadJob> m_compositeUploadJob;
+    LanPayloadChannelPool *m_payloadChannels;
+    QHash<QString, QPointer<LanPayloadStream>> m_payloadStreams;
     DeviceInfo m_deviceInfo;
 };
 
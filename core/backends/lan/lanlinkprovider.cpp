@@ -25,6 +25,7 @@
 #include <QHostInfo>
 #include <QMetaEnum>
 #include <QNetworkProxy>
+#include <QPointer>
 #include <QSslCipher>
 #include <QSslConfiguration>
 #include <QSslKey>
@@ -36,11 +37,58 @@
 #include "dbushelper.h"
 #include "kdeconnectconfig.h"
 #include "landevicelink.h"
+#include "linkcapabilities.h"
+#include "sslconfigurationcache.h"
 
 static const int MAX_UNPAIRED_CONNECTIONS = 42;
 static const int MAX_REMEMBERED_IDENTITY_PACKETS = 42;
 
-static const long MILLIS_DELAY_BETWEEN_CONNECTIONS_TO_SAME_DEVICE = 500;
+// Head start of each address over the next one when reconnecting to a known device (as in RFC 8305, "Happy Eyeballs")
+static const int MILLIS_DELAY_BETWEEN_RECONNECT_ADDRESSES = 250;
+// How long direct reconnects get before we announce ourselves to the whole network anyway
+static const int MILLIS_RECONNECT_BEFORE_ANNOUNCE = 1000;
+
+/**
+ * The connection attempts to the addresses of one known device, the first one to connect wins
+ */
+class ReconnectRace : public QObject
+{
+public:
+    ReconnectRace(ConnectScheduler *scheduler, QObject *parent)
+        : QObject(parent)
+        , scheduler(scheduler)
+    {
+    }
+
+    void join(QSslSocket *socket)
+    {
+        sockets.append(socket);
+        connect(socket, &QAbstractSocket::connected, this, [this, socket]() {
+            for (const QPointer<QSslSocket> &other : std::as_const(sockets)) {
+                if (other && other != socket) {
+                    // Losing the race isn't a failure of that address
+                    scheduler->cancel(other);
+                    other->abort();
+                    other->deleteLater();
+                }
+            }
+            deleteLater();
+        });
+        connect(socket, &QAbstractSocket::errorOccurred, this, &ReconnectRace::attemptFailed);
+    }
+
+    void attemptFailed()
+    {
+        remaining--;
+        if (remaining == 0) {
+            deleteLater();
+        }
+    }
+
+    ConnectScheduler *const scheduler;
+    QList<QPointer<QSslSocket>> sockets;
+    int remaining = 0;
+};
 
 LanLinkProvider::LanLinkProvider(bool testMode)
     : m_server(new Server(this))
@@ -48,6 +96,8 @@ LanLinkProvider::LanLinkProvider(bool testMode)
     , m_tcpPort(0)
     , m_testMode(testMode)
     , m_combineNetworkChangeTimer(this)
+    , m_pendingReconnects(0)
+    , m_reconnectAnnounceTimer(this)
 #ifdef KDECONNECT_MDNS
     , m_mdnsDiscovery(this)
 #endif
@@ -56,6 +106,10 @@ LanLinkProvider::LanLinkProvider(bool testMode)
     m_combineNetworkChangeTimer.setSingleShot(true);
     connect(&m_combineNetworkChangeTimer, &QTimer::timeout, this, &LanLinkProvider::combinedOnNetworkChange);
 
+    m_reconnectAnnounceTimer.setInterval(MILLIS_RECONNECT_BEFORE_ANNOUNCE);
+    m_reconnectAnnounceTimer.setSingleShot(true);
+    connect(&m_reconnectAnnounceTimer, &QTimer::timeout, this, &LanLinkProvider::announceIdentity);
+
     connect(&m_udpSocket, &QIODevice::readyRead, this, &LanLinkProvider::udpBroadcastReceived);
 
     m_server->setProxy(QNetworkProxy::NoProxy);
@@ -130,6 +184,7 @@ void LanLinkProvider::onStop()
 #ifdef KDECONNECT_MDNS
     m_mdnsDiscovery.onStop();
 #endif
+    m_connectScheduler.clear();
     m_udpSocket.close();
     m_server->close();
     qCDebug(KDECONNECT_CORE) << "LanLinkProvider stopped";
@@ -154,12 +209,111 @@ void LanLinkProvider::combinedOnNetworkChange()
 
     Q_ASSERT(m_tcpPort != 0);
 
+    // Known devices are usually still reachable where they were (e.g. after suspend/resume), connecting to them directly
+    // is faster than waiting for them to answer a broadcast
+    reconnectKnownPeers();
+    if (m_pendingReconnects > 0) {
+        // Devices answering the broadcast would only race the direct connections, give those a head start
+        m_reconnectAnnounceTimer.start();
+    } else {
+        announceIdentity();
+    }
+}
+
+void LanLinkProvider::announceIdentity()
+{
+    m_reconnectAnnounceTimer.stop();
     broadcastUdpIdentityPacket();
 #ifdef KDECONNECT_MDNS
     m_mdnsDiscovery.onNetworkChange();
 #endif
 }
 
+void LanLinkProvider::reconnectFinished()
+{
+    m_pendingReconnects--;
+    if (m_pendingReconnects == 0 && m_reconnectAnnounceTimer.isActive()) {
+        announceIdentity();
+    }
+}
+
+void LanLinkProvider::rememberPeer(const QString &deviceId, const QHostAddress &address, const NetworkPacket &identity)
+{
+    KnownPeer &peer = m_knownPeers[deviceId];
+    peer.identity = identity;
+    if (identity.has(QStringLiteral("tcpPort"))) {
+        peer.tcpPort = identity.get<int>(QStringLiteral("tcpPort"));
+    } else if (peer.tcpPort == 0) {
+        // Identities received over TCP don't include the port, devices listen on the first free one in the range
+        peer.tcpPort = MIN_TCP_PORT;
+    }
+
+    // Sockets listening on both protocols see IPv4 peers as IPv4-mapped IPv6 addresses
+    bool isIPv4;
+    const quint32 ipv4Address = address.toIPv4Address(&isIPv4);
+    const QHostAddress peerAddress = isIPv4 ? QHostAddress(ipv4Address) : address;
+    peer.addresses.removeIf([&peerAddress](const QHostAddress &known) {
+        return known.protocol() == peerAddress.protocol();
+    });
+    peer.addresses.prepend(peerAddress);
+}
+
+void LanLinkProvider::reconnectKnownPeers()
+{
+    const QStringList trustedDevices = KdeConnectConfig::instance().trustedDevices();
+    for (auto it = m_knownPeers.begin(); it != m_knownPeers.end();) {
+        if (!trustedDevices.contains(it.key())) {
+            it = m_knownPeers.erase(it);
+            continue;
+        }
+        // A new connection would replace the link, and with it the payloads and channels it's busy with
+        const LanDeviceLink *link = m_links.value(it.key());
+        if (!link || !link->isConnected()) {
+            reconnectKnownPeer(it.value());
+        }
+        ++it;
+    }
+}
+
+void LanLinkProvider::reconnectKnownPeer(const KnownPeer &peer)
+{
+    qCDebug(KDECONNECT_CORE) << "Reconnecting directly to" << peer.identity.get<QString>(QStringLiteral("deviceId")) << peer.addresses;
+
+    // We are the TCP client, so these connections are the TLS server side (see tcpSocketConnected()). Qt doesn't keep
+    // session ticket keys across server sockets, so unlike the connections a device makes to us, these always do a
+    // full handshake.
+
+    // Owns the timers of the attempts that haven't started yet, and goes away once the race is decided
+    ReconnectRace *race = new ReconnectRace(&m_connectScheduler, this);
+    race->remaining = peer.addresses.size();
+    m_pendingReconnects++;
+    connect(race, &QObject::destroyed, this, &LanLinkProvider::reconnectFinished);
+    // Attempts still running after this continue on their own, but don't hold back the announcement anymore
+    QTimer::singleShot(MILLIS_RECONNECT_BEFORE_ANNOUNCE, race, &QObject::deleteLater);
+
+    const QString deviceId = peer.identity.get<QString>(QStringLiteral("deviceId"));
+    for (int i = 0; i < peer.addresses.size(); i++) {
+        const QHostAddress address = peer.addresses[i];
+        QTimer::singleShot(i * MILLIS_DELAY_BETWEEN_RECONNECT_ADDRESSES, race, [this, race, address, peer, deviceId]() {
+            const QPointer<ReconnectRace> racing = race;
+            const bool scheduled = m_connectScheduler.schedule(deviceId, address, true, [this, racing, address, peer, deviceId]() -> QSslSocket * {
+                if (!racing && m_links.contains(deviceId)) {
+                    // Waited in the queue until the race was over, and another address won it
+                    return nullptr;
+                }
+                QSslSocket *socket = connectToPeer(new NetworkPacket(peer.identity), address, peer.tcpPort);
+                if (racing) {
+                    racing->join(socket);
+                }
+                return socket;
+            });
+            if (!scheduled) {
+                race->attemptFailed();
+            }
+        });
+    }
+}
+
 void LanLinkProvider::broadcastUdpIdentityPacket()
 {
     if (qEnvironmentVariableIsSet("KDECONNECT_DISABLE_UDP_BROADCAST")) {
@@ -247,6 +401,8 @@ void LanLinkProvider::sendUdpIdentityPacket(QUdpSocket &socket, const QList<QHos
 // I will create a TcpSocket and try to connect. This can result in either tcpSocketConnected() or connectError().
 void LanLinkProvider::udpBroadcastReceived()
 {
+    const QByteArray myDeviceId = KdeConnectConfig::instance().deviceId().toUtf8();
+
     while (m_udpSocket.hasPendingDatagrams()) {
         QByteArray datagram;
         datagram.resize(m_udpSocket.pendingDatagramSize());
@@ -257,6 +413,22 @@ void LanLinkProvider::udpBroadcastReceived()
         if (sender.isLoopback() && !m_testMode)
             continue;
 
+        // Under a broadcast storm most datagrams are our own, repeated, or from a device we just connected to.
+        // Turn those away before paying for a JSON parse or a socket.
+        const QByteArray peekedDeviceId = IdentityAdmission::peekDeviceId(datagram);
+        if (peekedDeviceId == myDeviceId) {
+            continue;
+        }
+        if (!peekedDeviceId.isEmpty() && !m_identityAdmission.admit(peekedDeviceId, datagram)) {
+            qCDebug(KDECONNECT_CORE) << "Discarding UDP packet from" << peekedDeviceId << "received too quickly";
+            continue;
+        }
+
+        if (m_receivedIdentityPackets.size() > MAX_REMEMBERED_IDENTITY_PACKETS) {
+            qCWarning(KDECONNECT_CORE) << "Too many remembered identities, ignoring" << peekedDeviceId << "received via UDP";
+            continue;
+        }
+
         NetworkPacket *receivedPacket = new NetworkPacket();
         bool success = NetworkPacket::unserialize(datagram, receivedPacket);
 
@@ -282,13 +454,12 @@ void LanLinkProvider::udpBroadcastReceived()
             continue;
         }
 
-        qint64 now = QDateTime::currentMSecsSinceEpoch();
-        if (m_lastConnectionTime[deviceId] + MILLIS_DELAY_BETWEEN_CONNECTIONS_TO_SAME_DEVICE > now) {
-            qCDebug(KDECONNECT_CORE) << "Discarding second UPD packet from the same device" << deviceId << "received too quickly";
+        // The id couldn't be found without parsing, or the peek found something else than the parser
+        if (peekedDeviceId != deviceId.toUtf8() && !m_identityAdmission.admit(deviceId.toUtf8(), datagram)) {
+            qCDebug(KDECONNECT_CORE) << "Discarding UDP packet from" << deviceId << "received too quickly";
             delete receivedPacket;
-            return;
+            continue;
         }
-        m_lastConnectionTime[deviceId] = now;
 
         int tcpPort = receivedPacket->get<int>(QStringLiteral("tcpPort"));
         if (tcpPort < MIN_TCP_PORT || tcpPort > MAX_TCP_PORT) {
@@ -299,26 +470,34 @@ void LanLinkProvider::udpBroadcastReceived()
 
         // qCDebug(KDECONNECT_CORE) << "Received Udp identity packet from" << sender << " asking for a tcp connection on port " << tcpPort;
 
-        if (m_receivedIdentityPackets.size() > MAX_REMEMBERED_IDENTITY_PACKETS) {
-            qCWarning(KDECONNECT_CORE) << "Too many remembered identities, ignoring" << receivedPacket->get<QString>(QStringLiteral("deviceId"))
-                                       << "received via UDP";
-            delete receivedPacket;
-            continue;
-        }
-
-        QSslSocket *socket = new QSslSocket(this);
-        socket->setProxy(QNetworkProxy::NoProxy);
-        m_receivedIdentityPackets[socket].np = receivedPacket;
-        m_receivedIdentityPackets[socket].sender = sender;
-        connect(socket, &QAbstractSocket::connected, this, &LanLinkProvider::tcpSocketConnected);
-        connect(socket, &QAbstractSocket::errorOccurred, this, &LanLinkProvider::connectError);
-        connect(socket, &QObject::destroyed, this, [this, socket]() {
-            delete m_receivedIdentityPackets.take(socket).np;
+        const bool isDeviceTrusted = KdeConnectConfig::instance().trustedDevices().contains(deviceId);
+        const NetworkPacket identityPacket = *receivedPacket;
+        delete receivedPacket;
+        const bool scheduled = m_connectScheduler.schedule(deviceId, sender, isDeviceTrusted, [this, identityPacket, sender, tcpPort]() {
+            return connectToPeer(new NetworkPacket(identityPacket), sender, tcpPort);
         });
-        socket->connectToHost(sender, tcpPort);
+        if (!scheduled) {
+            qCDebug(KDECONNECT_CORE) << "Not connecting to" << deviceId << "at" << sender
+                                     << "now, it's backing off, already being connected to or too many connections are waiting";
+        }
     }
 }
 
+QSslSocket *LanLinkProvider::connectToPeer(NetworkPacket *identityPacket, const QHostAddress &address, quint16 tcpPort)
+{
+    QSslSocket *socket = new QSslSocket(this);
+    socket->setProxy(QNetworkProxy::NoProxy);
+    m_receivedIdentityPackets[socket].np = identityPacket;
+    m_receivedIdentityPackets[socket].sender = address;
+    connect(socket, &QAbstractSocket::connected, this, &LanLinkProvider::tcpSocketConnected);
+    connect(socket, &QAbstractSocket::errorOccurred, this, &LanLinkProvider::connectError);
+    connect(socket, &QObject::destroyed, this, [this, socket]() {
+        delete m_receivedIdentityPackets.take(socket).np;
+    });
+    socket->connectToHost(address, tcpPort);
+    return socket;
+}
+
 void LanLinkProvider::connectError(QAbstractSocket::SocketError socketError)
 {
     QSslSocket *socket = qobject_cast<QSslSocket *>(sender());
@@ -326,6 +505,7 @@ void LanLinkProvider::connectError(QAbstractSocket::SocketError socketError)
         return;
 
     qCDebug(KDECONNECT_CORE) << "Socket error" << socketError;
+    // Attempts to a peer whose last one failed are held back by m_connectScheduler, and so are these packets
     qCDebug(KDECONNECT_CORE) << "Fallback (1), try reverse connection (send udp packet)" << socket->errorString();
     NetworkPacket np = KdeConnectConfig::instance().deviceInfo().toIdentityPacket();
     np.set(QStringLiteral("tcpPort"), m_tcpPort);
@@ -367,6 +547,7 @@ void LanLinkProvider::tcpSocketConnected()
         // if ssl supported
         bool isDeviceTrusted = KdeConnectConfig::instance().trustedDevices().contains(deviceId);
         configureSslSocket(socket, deviceId, isDeviceTrusted);
+        offerMultiplexedLink(socket, *receivedPacket, isDeviceTrusted);
 
         qCDebug(KDECONNECT_CORE) << "Starting server ssl (I'm the client TCP socket)";
 
@@ -400,6 +581,11 @@ void LanLinkProvider::encrypted()
 
     DeviceInfo deviceInfo = DeviceInfo::FromIdentityPacketAndCert(*identityPacket, socket->peerCertificate());
 
+    // Trusted devices pinned their certificate in the handshake, so the id can be relied on
+    if (KdeConnectConfig::instance().trustedDevices().contains(deviceInfo.id)) {
+        rememberPeer(deviceInfo.id, socket->peerAddress(), *identityPacket);
+    }
+
     // We don't delete the socket because now it's owned by the LanDeviceLink
     disconnect(socket, &QObject::destroyed, nullptr, nullptr);
     delete m_receivedIdentityPackets.take(socket).np;
@@ -512,6 +698,7 @@ void LanLinkProvider::dataReceived()
 
     bool isDeviceTrusted = KdeConnectConfig::instance().trustedDevices().contains(deviceId);
     configureSslSocket(socket, deviceId, isDeviceTrusted);
+    offerMultiplexedLink(socket, *np, isDeviceTrusted);
 
     qCDebug(KDECONNECT_CORE) << "Starting client ssl (but I'm the server TCP socket)";
 
@@ -534,25 +721,19 @@ void LanLinkProvider::onLinkDestroyed(const QString &deviceId, DeviceLink *oldPt
 void LanLinkProvider::configureSslSocket(QSslSocket *socket, const QString &deviceId, bool isDeviceTrusted)
 {
     // Configure for ssl
-    QSslConfiguration sslConfig;
-    sslConfig.setLocalCertificate(KdeConnectConfig::instance().certificate());
-
-    QFile privateKeyFile(KdeConnectConfig::instance().privateKeyPath());
-    QSslKey privateKey;
-    if (privateKeyFile.open(QIODevice::ReadOnly)) {
-        privateKey = QSslKey(privateKeyFile.readAll(), QSsl::Rsa);
-    }
-    privateKeyFile.close();
-    sslConfig.setPrivateKey(privateKey);
+    socket->setSslConfiguration(SslConfigurationCache::instance().configuration(deviceId, isDeviceTrusted));
 
     if (isDeviceTrusted) {
-        QSslCertificate certificate = KdeConnectConfig::instance().getTrustedDeviceCertificate(deviceId);
-        sslConfig.setCaCertificates({certificate});
-        sslConfig.setPeerVerifyMode(QSslSocket::VerifyPeer);
-    } else {
-        sslConfig.setPeerVerifyMode(QSslSocket::QueryPeer);
+        // Only sockets in client mode receive tickets, they let the next connection to this device resume the session
+        const auto storeSessionTicket = [socket, deviceId]() {
+            const QByteArray ticket = socket->sslConfiguration().sessionTicket();
+            if (!ticket.isEmpty()) {
+                SslConfigurationCache::instance().setSessionTicket(deviceId, ticket);
+            }
+        };
+        QObject::connect(socket, &QSslSocket::encrypted, socket, storeSessionTicket);
+        QObject::connect(socket, &QSslSocket::newSessionTicketReceived, socket, storeSessionTicket);
     }
-    socket->setSslConfiguration(sslConfig);
     socket->setPeerVerifyName(deviceId);
 
     // Usually SSL errors are only bad for trusted devices. Uncomment this section to log errors in any case, for debugging.
@@ -564,6 +745,22 @@ void LanLinkProvider::configureSslSocket(QSslSocket *socket, const QString &devi
     // });
 }
 
+void LanLinkProvider::offerMultiplexedLink(QSslSocket *socket, const NetworkPacket &identityPacket, bool isDeviceTrusted)
+{
+    // Hosts that aren't paired don't get the multiplexer's buffers. Each end decides on its own whether it trusts the other, so the
+    // handshake is what they agree on: a link is only multiplexed when the protocol was offered on both ends.
+    if (!isDeviceTrusted || !KdeConnectConfig::instance().multiplexedLinks()) {
+        return;
+    }
+    if (!identityPacket.get<QStringList>(QStringLiteral("linkCapabilities")).contains(LINK_CAPABILITY_MULTIPLEXED_LINK)) {
+        return;
+    }
+
+    QSslConfiguration configuration = socket->sslConfiguration();
+    configuration.setAllowedNextProtocols({LINK_MULTIPLEXED_LINK_ALPN});
+    socket->setSslConfiguration(configuration);
+}
+
 void LanLinkProvider::configureSocket(QSslSocket *socket)
 {
     socket->setProxy(QNetworkProxy::NoProxy);
@@ -627,7 +824,7 @@ void LanLinkProvider::addLink(QSslSocket *socket, const DeviceInfo &deviceInfo)
             return;
         }
         // qCDebug(KDECONNECT_CORE) << "Reusing link to" << deviceId;
-        deviceLink->reset(socket);
+        deviceLink->reset(socket, deviceInfo);
     } else {
         deviceLink = new LanDeviceLink(deviceInfo, this, socket);
         // Socket disconnection will now be handled by LanDeviceLink
@@ -7,6 +7,7 @@
 #ifndef LANLINKPROVIDER_H
 #define LANLINKPROVIDER_H
 
+#include <QHash>
 #include <QNetworkInformation>
 #include <QObject>
 #include <QSslSocket>
@@ -15,6 +16,8 @@
 #include <QUdpSocket>
 
 #include "backends/linkprovider.h"
+#include "connectscheduler.h"
+#include "identityadmission.h"
 #include "kdeconnectcore_export.h"
 #include "landevicelink.h"
 #include "server.h"
@@ -46,6 +49,11 @@ public:
     void sendUdpIdentityPacket(const QList<QHostAddress> &addresses);
 
     static void configureSslSocket(QSslSocket *socket, const QString &deviceId, bool isDeviceTrusted);
+    /**
+     * Offer to multiplex the device link in the TLS handshake, if we and the device want that and it is trusted.
+     * The link is multiplexed when both ends offered it, see LanDeviceLink.
+     */
+    static void offerMultiplexedLink(QSslSocket *socket, const NetworkPacket &identityPacket, bool isDeviceTrusted);
     static void configureSocket(QSslSocket *socket);
 
     /**
@@ -70,12 +78,24 @@ private Q_SLOTS:
     void dataReceived();
     void sslErrors(const QList<QSslError> &errors);
     void combinedOnNetworkChange();
+    void reconnectFinished();
 
 private:
     void addLink(QSslSocket *socket, const DeviceInfo &deviceInfo);
     QList<QHostAddress> getBroadcastAddresses();
     void sendUdpIdentityPacket(QUdpSocket &socket, const QList<QHostAddress> &addresses);
     void broadcastUdpIdentityPacket();
+    void announceIdentity();
+    QSslSocket *connectToPeer(NetworkPacket *identityPacket, const QHostAddress &address, quint16 tcpPort);
+
+    struct KnownPeer {
+        QList<QHostAddress> addresses; // The last address of each protocol, most recent first
+        quint16 tcpPort = 0;
+        NetworkPacket identity;
+    };
+    void rememberPeer(const QString &deviceId, const QHostAddress &address, const NetworkPacket &identity);
+    void reconnectKnownPeers();
+    void reconnectKnownPeer(const KnownPeer &peer);
 
     Server *m_server;
     QUdpSocket m_udpSocket;
@@ -88,10 +108,16 @@ private:
         QHostAddress sender;
     };
     QMap<QSslSocket *, PendingConnect> m_receivedIdentityPackets;
-    QMap<QString, qint64> m_lastConnectionTime;
+    IdentityAdmission m_identityAdmission;
+    ConnectScheduler m_connectScheduler;
     const bool m_testMode;
     QTimer m_combineNetworkChangeTimer;
 
+    // Where trusted devices were last connected, so they can be reconnected directly after a network change
+    QHash<QString, KnownPeer> m_knownPeers;
+    int m_pendingReconnects;
+    QTimer m_reconnectAnnounceTimer;
+
 #ifdef KDECONNECT_MDNS
     MdnsDiscovery m_mdnsDiscovery;
 #endif
@@ -0,0 +1,80 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "lanpayloadchannelpool.h"
+
+#include <QTimer>
+
+#include "core_debug.h"
+
+LanPayloadChannelPool::LanPayloadChannelPool(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QSslSocket *LanPayloadChannelPool::lease(QString *streamId)
+{
+    while (!m_channels.isEmpty()) {
+        // The most recently used connection is the least likely to have been dropped by the network
+        const Channel channel = m_channels.takeLast();
+        delete channel.idleTimer;
+        QSslSocket *socket = channel.socket;
+        if (!socket) {
+            continue;
+        }
+
+        socket->disconnect(this);
+        if (socket->state() != QAbstractSocket::ConnectedState || !socket->isEncrypted()) {
+            socket->deleteLater();
+            continue;
+        }
+
+        socket->setParent(nullptr);
+        *streamId = channel.streamId;
+        return socket;
+    }
+    return nullptr;
+}
+
+void LanPayloadChannelPool::release(QSslSocket *socket, const QString &streamId)
+{
+    if (socket->state() != QAbstractSocket::ConnectedState || m_channels.size() >= MAX_IDLE_CHANNELS) {
+        socket->disconnectFromHost();
+        socket->deleteLater();
+        return;
+    }
+
+    socket->setParent(this);
+
+    QTimer *idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    connect(idleTimer, &QTimer::timeout, this, [this, socket]() {
+        qCDebug(KDECONNECT_CORE) << "Closing idle payload connection";
+        remove(socket);
+        socket->disconnectFromHost();
+        socket->deleteLater();
+    });
+    idleTimer->start(IDLE_TIMEOUT_MS);
+
+    connect(socket, &QAbstractSocket::disconnected, this, [this, socket]() {
+        remove(socket);
+        socket->deleteLater();
+    });
+
+    m_channels.append({socket, streamId, idleTimer});
+}
+
+void LanPayloadChannelPool::remove(QSslSocket *socket)
+{
+    for (int i = 0; i < m_channels.size(); i++) {
+        if (m_channels.at(i).socket == socket) {
+            m_channels.takeAt(i).idleTimer->deleteLater();
+            return;
+        }
+    }
+}
+
+#include "moc_lanpayloadchannelpool.cpp"
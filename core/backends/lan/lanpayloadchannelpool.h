@@ -0,0 +1,59 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef LANPAYLOADCHANNELPOOL_H
+#define LANPAYLOADCHANNELPOOL_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QSslSocket>
+#include <QString>
+#include <QTimer>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * Idle payload stream connections to a single device, kept open for the next uploads.
+ *
+ * A CompositeUploadJob that sends streamed payloads leases a connection when it starts and releases
+ * it when it is done, so payloads sent shortly after each other skip the TCP and TLS handshakes. The
+ * receiving end keeps its LanPayloadStream for as long as the connection is open, and finds it again
+ * by the stream id. Connections that stay idle for IDLE_TIMEOUT_MS get closed.
+ */
+class KDECONNECTCORE_EXPORT LanPayloadChannelPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LanPayloadChannelPool(QObject *parent = nullptr);
+
+    /**
+     * Takes an idle connection out of the pool, the caller becomes its owner.
+     * Returns nullptr if there is none, otherwise @p streamId is set to the id of its stream.
+     */
+    QSslSocket *lease(QString *streamId);
+    /**
+     * Gives back a connection that has no payload in progress, the pool takes ownership.
+     */
+    void release(QSslSocket *socket, const QString &streamId);
+
+    constexpr static int MAX_IDLE_CHANNELS = 2;
+    constexpr static int IDLE_TIMEOUT_MS = 30000;
+
+private:
+    struct Channel {
+        QPointer<QSslSocket> socket;
+        QString streamId;
+        QTimer *idleTimer;
+    };
+
+    void remove(QSslSocket *socket);
+
+    QList<Channel> m_channels;
+};
+
+#endif // LANPAYLOADCHANNELPOOL_H
@@ -0,0 +1,236 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "lanpayloadstream.h"
+
+#include <QtEndian>
+
+#include "core_debug.h"
+
+// Payloads nobody is reading yet shouldn't pile up in memory, let TCP hold back the sender instead
+static const qint64 MAX_READ_BUFFER_SIZE = 1024 * 1024;
+
+static const int CLOSED_STREAM_TIMEOUT_MS = 10000;
+
+LanPayloadStream::LanPayloadStream(QSslSocket *socket, QObject *parent)
+    : QObject(parent)
+    , m_socket(socket)
+    , m_frameRemaining(-1)
+    , m_closed(false)
+{
+    m_closeTimer.setSingleShot(true);
+    m_closeTimer.setInterval(CLOSED_STREAM_TIMEOUT_MS);
+    connect(&m_closeTimer, &QTimer::timeout, this, &QObject::deleteLater);
+
+    m_socket->setParent(this);
+    m_socket->setReadBufferSize(MAX_READ_BUFFER_SIZE);
+
+    connect(m_socket, &QIODevice::readyRead, this, &LanPayloadStream::dispatch);
+    connect(m_socket, &QAbstractSocket::disconnected, this, &LanPayloadStream::socketDisconnected);
+    connect(m_socket, &QAbstractSocket::errorOccurred, this, [this](QAbstractSocket::SocketError error) {
+        qCDebug(KDECONNECT_CORE) << "Payload stream socket error" << error;
+        socketDisconnected();
+    });
+}
+
+LanPayloadStream::~LanPayloadStream()
+{
+    for (const QPointer<LanPayloadSlice> &slice : std::as_const(m_slices)) {
+        if (slice) {
+            slice->m_finished = true;
+        }
+    }
+}
+
+QSharedPointer<QIODevice> LanPayloadStream::nextPayload()
+{
+    LanPayloadSlice *slice = new LanPayloadSlice(this);
+    m_slices.append(slice);
+    m_closeTimer.stop();
+
+    // The frame might be buffered already, and there won't be another readyRead for it
+    QMetaObject::invokeMethod(this, &LanPayloadStream::dispatch, Qt::QueuedConnection);
+
+    return QSharedPointer<QIODevice>(slice);
+}
+
+void LanPayloadStream::dispatch()
+{
+    while (!m_slices.isEmpty()) {
+        if (m_frameRemaining < 0) {
+            if (m_socket->bytesAvailable() < FRAME_HEADER_SIZE) {
+                break;
+            }
+            char header[FRAME_HEADER_SIZE];
+            m_socket->read(header, FRAME_HEADER_SIZE);
+            m_frameRemaining = qFromBigEndian<qint64>(header);
+            if (m_frameRemaining < 0) {
+                qCWarning(KDECONNECT_CORE) << "Invalid payload frame length, closing payload stream";
+                m_socket->abort();
+                return;
+            }
+        }
+
+        if (m_frameRemaining == 0) {
+            completeFrame();
+            continue;
+        }
+
+        LanPayloadSlice *slice = m_slices.constFirst();
+        if (!slice) {
+            // Nobody wants this payload anymore
+            const qint64 skipped = m_socket->skip(qMin(m_frameRemaining, m_socket->bytesAvailable()));
+            if (skipped <= 0) {
+                break;
+            }
+            m_frameRemaining -= skipped;
+            continue;
+        }
+
+        if (m_socket->bytesAvailable() > 0) {
+            Q_EMIT slice->readyRead();
+            return;
+        }
+        break;
+    }
+
+    if (!m_closed) {
+        return;
+    }
+
+    if (m_slices.isEmpty() && m_socket->bytesAvailable() > 0) {
+        // Frames for packets that haven't been received on the device link yet, give them a moment to arrive
+        if (!m_closeTimer.isActive()) {
+            m_closeTimer.start();
+        }
+        return;
+    }
+
+    // Nothing else will arrive, whatever is still pending won't get its data
+    for (const QPointer<LanPayloadSlice> &slice : std::as_const(m_slices)) {
+        if (slice) {
+            slice->finish();
+        }
+    }
+    m_slices.clear();
+    deleteLater();
+}
+
+void LanPayloadStream::completeFrame()
+{
+    QPointer<LanPayloadSlice> slice = m_slices.takeFirst();
+    m_frameRemaining = -1;
+    if (slice) {
+        slice->finish();
+    }
+    QMetaObject::invokeMethod(this, &LanPayloadStream::dispatch, Qt::QueuedConnection);
+}
+
+void LanPayloadStream::socketDisconnected()
+{
+    if (m_closed) {
+        return;
+    }
+    m_closed = true;
+
+    QMetaObject::invokeMethod(this, &LanPayloadStream::dispatch, Qt::QueuedConnection);
+}
+
+qint64 LanPayloadStream::frameBytesAvailable(const LanPayloadSlice *slice) const
+{
+    if (m_slices.isEmpty() || m_slices.constFirst() != slice || m_frameRemaining <= 0) {
+        return 0;
+    }
+    return qMin(m_frameRemaining, m_socket->bytesAvailable());
+}
+
+qint64 LanPayloadStream::readFrameData(const LanPayloadSlice *slice, char *data, qint64 maxlen)
+{
+    if (m_slices.isEmpty() || m_slices.constFirst() != slice || m_frameRemaining <= 0) {
+        return 0;
+    }
+
+    const qint64 bytesRead = m_socket->read(data, qMin(maxlen, m_frameRemaining));
+    if (bytesRead <= 0) {
+        if (m_closed) {
+            QMetaObject::invokeMethod(this, &LanPayloadStream::dispatch, Qt::QueuedConnection);
+        }
+        return 0;
+    }
+
+    m_frameRemaining -= bytesRead;
+    if (m_frameRemaining == 0) {
+        completeFrame();
+    }
+    return bytesRead;
+}
+
+qint64 LanPayloadStream::writeData(const char *data, qint64 len)
+{
+    return m_socket->write(data, len);
+}
+
+LanPayloadSlice::LanPayloadSlice(LanPayloadStream *stream)
+    : m_stream(stream)
+    , m_finished(false)
+{
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+LanPayloadSlice::~LanPayloadSlice()
+{
+    // If we were still waiting for our frame, the stream will skip it
+    if (m_stream && !m_finished) {
+        QMetaObject::invokeMethod(m_stream.data(), &LanPayloadStream::dispatch, Qt::QueuedConnection);
+    }
+}
+
+void LanPayloadSlice::finish()
+{
+    m_finished = true;
+    // Queued, we might be inside a read() of this very device
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            Q_EMIT readChannelFinished();
+        },
+        Qt::QueuedConnection);
+}
+
+bool LanPayloadSlice::isSequential() const
+{
+    return true;
+}
+
+bool LanPayloadSlice::atEnd() const
+{
+    return (m_finished || !m_stream) && bytesAvailable() == 0;
+}
+
+qint64 LanPayloadSlice::bytesAvailable() const
+{
+    const qint64 frameBytes = m_stream ? m_stream->frameBytesAvailable(this) : 0;
+    return frameBytes + QIODevice::bytesAvailable();
+}
+
+qint64 LanPayloadSlice::readData(char *data, qint64 maxlen)
+{
+    const qint64 bytesRead = m_stream ? m_stream->readFrameData(this, data, maxlen) : 0;
+    if (bytesRead == 0 && (m_finished || !m_stream)) {
+        return -1;
+    }
+    return bytesRead;
+}
+
+qint64 LanPayloadSlice::writeData(const char *data, qint64 len)
+{
+    if (!m_stream) {
+        return -1;
+    }
+    return m_stream->writeData(data, len);
+}
+
+#include "moc_lanpayloadstream.cpp"
@@ -0,0 +1,95 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef LANPAYLOADSTREAM_H
+#define LANPAYLOADSTREAM_H
+
+#include <QIODevice>
+#include <QList>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QSslSocket>
+#include <QTimer>
+
+#include "kdeconnectcore_export.h"
+
+class LanPayloadSlice;
+
+/**
+ * The receiving end of a payload connection that carries several payloads back to back.
+ *
+ * Every payload is sent as a frame: its length (8 bytes, Big-Endian) followed by that many bytes.
+ * Frames are handed out in order to the devices returned by nextPayload(), so packets must ask for
+ * their payload in the order they were received. A payload device that gets destroyed before reading
+ * all of its frame has the rest of it discarded.
+ */
+class KDECONNECTCORE_EXPORT LanPayloadStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Takes ownership of @p socket. The stream deletes itself once the socket disconnects
+     * and every frame it received has been handed out.
+     */
+    explicit LanPayloadStream(QSslSocket *socket, QObject *parent = nullptr);
+    ~LanPayloadStream() override;
+
+    QSharedPointer<QIODevice> nextPayload();
+
+    constexpr static int FRAME_HEADER_SIZE = 8;
+
+private:
+    void dispatch();
+    void completeFrame();
+    void socketDisconnected();
+
+    qint64 frameBytesAvailable(const LanPayloadSlice *slice) const;
+    qint64 readFrameData(const LanPayloadSlice *slice, char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+
+    QSslSocket *m_socket;
+    // Pending payloads in frame order, null entries have been abandoned and their frame gets discarded
+    QList<QPointer<LanPayloadSlice>> m_slices;
+    // Bytes left in the current frame, -1 while waiting for the frame header
+    qint64 m_frameRemaining;
+    bool m_closed;
+    QTimer m_closeTimer;
+
+    friend class LanPayloadSlice;
+};
+
+/**
+ * A single payload of a LanPayloadStream
+ *
+ * @internal
+ */
+class LanPayloadSlice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    ~LanPayloadSlice() override;
+
+    bool isSequential() const override;
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    explicit LanPayloadSlice(LanPayloadStream *stream);
+    void finish();
+
+    QPointer<LanPayloadStream> m_stream;
+    bool m_finished;
+
+    friend class LanPayloadStream;
+};
+
+#endif // LANPAYLOADSTREAM_H
@@ -0,0 +1,223 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "lanstripedpayload.h"
+
+#include <QtEndian>
+
+#include "core_debug.h"
+
+// Ranges ahead of the one being read in order only get buffered up to this, then TCP holds back their sender
+static const qint64 MAX_STRIPE_BUFFER_SIZE = 1024 * 1024;
+
+LanStripedPayload::LanStripedPayload(const QList<QSslSocket *> &sockets, qint64 size, QObject *parent)
+    : QIODevice(parent)
+    , m_claimedRanges(sockets.size(), false)
+    , m_size(size)
+    , m_position(0)
+    , m_nextStripe(0)
+    , m_failed(false)
+    , m_finished(false)
+{
+    for (int i = 0; i < sockets.size(); i++) {
+        QSslSocket *socket = sockets[i];
+        socket->setParent(this);
+        socket->setReadBufferSize(MAX_STRIPE_BUFFER_SIZE);
+        m_stripes.append({socket, -1, -1, 0});
+
+        connect(socket, &QIODevice::readyRead, this, [this, i]() {
+            socketReadyRead(i);
+        });
+        connect(socket, &QAbstractSocket::disconnected, this, [this, i]() {
+            socketDisconnected(i);
+        });
+        connect(socket, &QAbstractSocket::errorOccurred, this, [this, i](QAbstractSocket::SocketError error) {
+            qCDebug(KDECONNECT_CORE) << "Payload stripe socket error" << error;
+            socketDisconnected(i);
+        });
+    }
+
+    QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void LanStripedPayload::socketReadyRead(int index)
+{
+    Stripe &stripe = m_stripes[index];
+    if (stripe.length < 0) {
+        if (stripe.socket->bytesAvailable() < STRIPE_HEADER_SIZE) {
+            return;
+        }
+        char header[STRIPE_HEADER_SIZE];
+        stripe.socket->read(header, STRIPE_HEADER_SIZE);
+        stripe.offset = qFromBigEndian<qint64>(header);
+        stripe.length = qFromBigEndian<qint64>(header + 8);
+        if (claimRange(stripe.offset, stripe.length) < 0) {
+            qCWarning(KDECONNECT_CORE) << "Invalid payload stripe" << stripe.offset << stripe.length << "for a payload of size" << m_size;
+            fail();
+            return;
+        }
+        // An empty range is complete already
+        checkFinished();
+    }
+
+    if (stripeBytesAvailable(stripe) > 0) {
+        Q_EMIT readyRead();
+    }
+}
+
+void LanStripedPayload::socketDisconnected(int index)
+{
+    const Stripe &stripe = m_stripes[index];
+    const qint64 expected = stripe.length < 0 ? STRIPE_HEADER_SIZE : stripe.length - stripe.consumed;
+    if (stripe.socket->bytesAvailable() < expected) {
+        qCWarning(KDECONNECT_CORE) << "Payload stripe connection closed before its range was complete";
+        fail();
+    }
+}
+
+int LanStripedPayload::claimRange(qint64 offset, qint64 length)
+{
+    const int count = m_claimedRanges.size();
+    for (int i = 0; i < count; i++) {
+        const qint64 rangeOffset = m_size * i / count;
+        const qint64 rangeEnd = m_size * (i + 1) / count;
+        // Empty ranges share their offset, any one that's still free will do
+        if (!m_claimedRanges[i] && offset == rangeOffset && length == rangeEnd - rangeOffset) {
+            m_claimedRanges[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+qint64 LanStripedPayload::stripeBytesAvailable(const Stripe &stripe) const
+{
+    if (stripe.length < 0) {
+        return 0;
+    }
+    return qMin(stripe.length - stripe.consumed, stripe.socket->bytesAvailable());
+}
+
+qint64 LanStripedPayload::readStripe(Stripe &stripe, char *data, qint64 maxlen)
+{
+    const qint64 bytesRead = stripe.socket->read(data, qMin(maxlen, stripe.length - stripe.consumed));
+    if (bytesRead <= 0) {
+        return 0;
+    }
+    stripe.consumed += bytesRead;
+    checkFinished();
+    return bytesRead;
+}
+
+qint64 LanStripedPayload::rangeBytesAvailable() const
+{
+    qint64 available = 0;
+    for (const Stripe &stripe : m_stripes) {
+        available += stripeBytesAvailable(stripe);
+    }
+    return available;
+}
+
+qint64 LanStripedPayload::readAnyRange(char *data, qint64 maxlen, qint64 *offset)
+{
+    // Round robin, so one fast connection doesn't leave the others stalled on a full buffer
+    for (int i = 0; i < m_stripes.size(); i++) {
+        Stripe &stripe = m_stripes[(m_nextStripe + i) % m_stripes.size()];
+        if (stripeBytesAvailable(stripe) <= 0) {
+            continue;
+        }
+        m_nextStripe = (m_nextStripe + i + 1) % m_stripes.size();
+        *offset = stripe.offset + stripe.consumed;
+        return readStripe(stripe, data, maxlen);
+    }
+    return (m_finished || m_failed) ? -1 : 0;
+}
+
+bool LanStripedPayload::isSequential() const
+{
+    return true;
+}
+
+bool LanStripedPayload::atEnd() const
+{
+    return (m_finished || m_failed) && rangeBytesAvailable() == 0;
+}
+
+qint64 LanStripedPayload::bytesAvailable() const
+{
+    for (const Stripe &stripe : m_stripes) {
+        if (stripe.length >= 0 && stripe.offset + stripe.consumed == m_position && stripe.consumed < stripe.length) {
+            return stripeBytesAvailable(stripe) + QIODevice::bytesAvailable();
+        }
+    }
+    return QIODevice::bytesAvailable();
+}
+
+qint64 LanStripedPayload::readData(char *data, qint64 maxlen)
+{
+    for (Stripe &stripe : m_stripes) {
+        if (stripe.length >= 0 && stripe.offset + stripe.consumed == m_position && stripe.consumed < stripe.length) {
+            const qint64 bytesRead = readStripe(stripe, data, maxlen);
+            m_position += bytesRead;
+            if (stripe.consumed == stripe.length && bytesAvailable() > 0) {
+                // The next range might have filled its buffer already, it won't signal again by itself
+                QMetaObject::invokeMethod(
+                    this,
+                    [this]() {
+                        Q_EMIT readyRead();
+                    },
+                    Qt::QueuedConnection);
+            }
+            return bytesRead;
+        }
+    }
+    return (m_finished || m_failed) ? -1 : 0;
+}
+
+qint64 LanStripedPayload::writeData(const char * /*data*/, qint64 /*len*/)
+{
+    return -1;
+}
+
+void LanStripedPayload::fail()
+{
+    if (m_failed || m_finished) {
+        return;
+    }
+    m_failed = true;
+    for (const Stripe &stripe : std::as_const(m_stripes)) {
+        stripe.socket->abort();
+    }
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            Q_EMIT readChannelFinished();
+        },
+        Qt::QueuedConnection);
+}
+
+void LanStripedPayload::checkFinished()
+{
+    if (m_finished || m_failed) {
+        return;
+    }
+    // The ranges don't overlap and cover the payload, so it's complete once every one of them is
+    for (const Stripe &stripe : std::as_const(m_stripes)) {
+        if (stripe.length < 0 || stripe.consumed < stripe.length) {
+            return;
+        }
+    }
+    m_finished = true;
+    // Queued, we are inside a read() of this very device
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            Q_EMIT readChannelFinished();
+        },
+        Qt::QueuedConnection);
+}
+
+#include "moc_lanstripedpayload.cpp"
@@ -0,0 +1,74 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef LANSTRIPEDPAYLOAD_H
+#define LANSTRIPEDPAYLOAD_H
+
+#include <QIODevice>
+#include <QList>
+#include <QSslSocket>
+
+#include "kdeconnectcore_export.h"
+#include "rangedpayload.h"
+
+/**
+ * The receiving end of a payload that was split in ranges, each sent over its own payload connection.
+ *
+ * Every connection starts with a stripe header: the offset and the length of its range
+ * (8 bytes each, Big-Endian), followed by the data of that range. With n connections, the payload is split into the
+ * ranges [size * i / n, size * (i + 1) / n), and each of them has to come over exactly one connection.
+ */
+class KDECONNECTCORE_EXPORT LanStripedPayload : public QIODevice, public RangedPayload
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Takes ownership of @p sockets
+     */
+    LanStripedPayload(const QList<QSslSocket *> &sockets, qint64 size, QObject *parent = nullptr);
+
+    bool isSequential() const override;
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+    qint64 rangeBytesAvailable() const override;
+    qint64 readAnyRange(char *data, qint64 maxlen, qint64 *offset) override;
+
+    constexpr static int STRIPE_HEADER_SIZE = 16;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    struct Stripe {
+        QSslSocket *socket;
+        qint64 offset;
+        qint64 length;
+        qint64 consumed;
+    };
+
+    void socketReadyRead(int index);
+    void socketDisconnected(int index);
+    int claimRange(qint64 offset, qint64 length);
+    qint64 stripeBytesAvailable(const Stripe &stripe) const;
+    qint64 readStripe(Stripe &stripe, char *data, qint64 maxlen);
+    void fail();
+    void checkFinished();
+
+    QList<Stripe> m_stripes;
+    // Which of the ranges the sender splits the payload into already arrived on a connection
+    QList<bool> m_claimedRanges;
+    qint64 m_size;
+    // Position of the next byte returned by an in-order read
+    qint64 m_position;
+    int m_nextStripe;
+    bool m_failed;
+    bool m_finished;
+};
+
+#endif // LANSTRIPEDPAYLOAD_H
@@ -10,8 +10,10 @@
 
 #include "mdns.h"
 
+#include <algorithm>
 #include <errno.h>
 
+#include <QElapsedTimer>
 #include <QHostInfo>
 #include <QNetworkInterface>
 #include <QSocketNotifier>
@@ -99,7 +101,6 @@ static int query_callback(int sock,
     Q_UNUSED(query_id);
     Q_UNUSED(entry_type);
     Q_UNUSED(rclass);
-    Q_UNUSED(ttl);
     Q_UNUSED(name_offset);
     Q_UNUSED(name_length);
 
@@ -107,6 +108,7 @@ static int query_callback(int sock,
     // entryTypeToStr(entry_type);
 
     Discoverer::MdnsService *discoveredService = (Discoverer::MdnsService *)user_data;
+    discoveredService->ttl = qMin(discoveredService->ttl, ttl);
 
     switch (record_type) {
     case MDNS_RECORDTYPE_PTR: {
@@ -155,6 +157,17 @@ static int query_callback(int sock,
     return 0;
 }
 
+// Answers arriving within this time of each other are reported together
+static const int MILLIS_COALESCE_ANSWERS = 100;
+
+Discoverer::Discoverer()
+{
+    coalesceTimer.setInterval(MILLIS_COALESCE_ANSWERS);
+    coalesceTimer.setSingleShot(true);
+    connect(&coalesceTimer, &QTimer::timeout, this, &Discoverer::emitPendingServices);
+    clock.start();
+}
+
 void Discoverer::startDiscovering(const QString &serviceType)
 {
     int num_sockets = listenForQueryResponses();
@@ -168,6 +181,87 @@ void Discoverer::startDiscovering(const QString &serviceType)
 void Discoverer::stopDiscovering()
 {
     stopListeningForQueryResponses();
+    // Discovering again (e.g. on a new network) reports every service again
+    discoveredServices.clear();
+    pendingServices.clear();
+    coalesceTimer.stop();
+}
+
+void Discoverer::serviceReceived(const MdnsService &service)
+{
+    if (service.name.isEmpty()) {
+        // Nothing in the packet was an answer to our query
+        return;
+    }
+
+    if (service.ttl == 0) {
+        // A goodbye, the service counts as new if it comes back
+        discoveredServices.remove(service.name);
+        pendingServices.remove(service.name);
+        return;
+    }
+
+    const qint64 now = clock.elapsed();
+    const qint64 expiresAt = now + qint64(service.ttl) * 1000;
+    auto cached = discoveredServices.find(service.name);
+    if (cached != discoveredServices.end() && cached->expiresAt <= now) {
+        discoveredServices.erase(cached);
+        cached = discoveredServices.end();
+    }
+
+    bool changed = false;
+    if (cached == discoveredServices.end()) {
+        discoveredServices.removeIf([now](const QHash<QString, CachedService>::iterator &it) {
+            return it->expiresAt <= now;
+        });
+        CachedService newService{service, {}, expiresAt};
+        if (!service.address.isNull()) {
+            newService.addresses.append(service.address);
+            changed = true;
+        }
+        discoveredServices.insert(service.name, newService);
+    } else {
+        cached->expiresAt = qMax(cached->expiresAt, expiresAt);
+        if (!service.address.isNull() && !cached->addresses.contains(service.address)) {
+            cached->addresses.append(service.address);
+            // Answers without an A record that came in over IPv6 carry the sender's IPv6 address, which adds nothing if we already know an IPv4 one
+            const bool knownOverIPv4 = std::any_of(cached->addresses.cbegin(), cached->addresses.cend(), [](const QHostAddress &address) {
+                return address.protocol() == QAbstractSocket::IPv4Protocol;
+            });
+            if (service.address.protocol() == QAbstractSocket::IPv4Protocol || !knownOverIPv4) {
+                // Reachable at another address as well, or it moved
+                cached->service.address = service.address;
+                changed = true;
+            }
+        }
+        // Not every answer carries the SRV and TXT records
+        if (service.port != 0 && service.port != cached->service.port) {
+            cached->service.port = service.port;
+            changed = true;
+        }
+        if (!service.txtRecords.isEmpty() && service.txtRecords != cached->service.txtRecords) {
+            cached->service.txtRecords = service.txtRecords;
+            changed = true;
+        }
+        changed = changed && !cached->addresses.isEmpty();
+    }
+    if (!changed) {
+        return;
+    }
+
+    // The cached service merges every answer so far, so with answers arriving on several sockets at once we report one, preferring IPv4
+    pendingServices.insert(service.name, discoveredServices.value(service.name).service);
+    if (!coalesceTimer.isActive()) {
+        coalesceTimer.start();
+    }
+}
+
+void Discoverer::emitPendingServices()
+{
+    const QHash<QString, MdnsService> services = std::exchange(pendingServices, {});
+    for (const MdnsService &service : services) {
+        Q_EMIT serviceFound(service);
+    }
 }
 
 void Discoverer::stopListeningForQueryResponses()
@@ -226,7 +320,7 @@ int Discoverer::listenForQueryResponses()
             // qCDebug(KDECONNECT_CORE) << "Discovered service" << discoveredService.name << "at" << discoveredService.address << "in" <<  num_records <<
             // "records via socket" << socket;
 
-            Q_EMIT serviceFound(discoveredService);
+            serviceReceived(discoveredService);
         });
         responseSocketNotifiers.append(socketNotifier);
     }
@@ -362,7 +456,213 @@ static mdns_record_t createMdnsRecord(const Announcer::AnnouncedInfo &self,
     return answer;
 }
 
-// Callback handling questions incoming on service sockets
+// The TTL mdns.h gives multicast answers
+static const uint32_t ANSWER_TTL = 60;
+// RFC 6762 section 6: a record is multicast at most once per second on each interface
+static const qint64 MIN_MILLIS_BETWEEN_MULTICASTS = 1000;
+// RFC 6762 section 17: mDNS packets may be up to 9000 bytes
+static const int MAX_PACKET_SIZE = 9000;
+
+// The questions we answer, named after the record they are answered with
+enum AnswerKind {
+    DnsSdPtrAnswer,
+    ServicePtrAnswer,
+    ServiceSrvAnswer,
+    HostAAnswer,
+    HostAaaaAnswer,
+    ANSWER_KIND_COUNT,
+};
+
+struct PreparedAnswer {
+    bool valid = false;
+    mdns_record_t answer;
+    QVector<mdns_record_t> additional;
+    QByteArray multicastPacket; // The complete multicast response, sent as it is
+};
+
+struct MulticastKey {
+    int socket;
+    int kind;
+    quint32 address;
+
+    bool operator==(const MulticastKey &other) const
+    {
+        return socket == other.socket && kind == other.kind && address == other.address;
+    }
+};
+
+static size_t qHash(const MulticastKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.socket, key.kind, key.address);
+}
+
+/**
+ * The answers to every question we respond to, built once from the announced info.
+ *
+ * The A record depends on which of our IPv4 addresses is on the querier's network, so there is a set of answers for
+ * each IPv4 address (or a single one keyed 0 when we have none).
+ */
+struct Announcer::AnswerCache {
+    QHash<quint32, QVector<PreparedAnswer>> answers;
+    QHash<MulticastKey, qint64> lastMulticast;
+    QElapsedTimer clock;
+};
+
+// Serializes a multicast response the way mdns_query_answer_multicast() does, without sending it
+static QByteArray serializeMulticastAnswer(const mdns_record_t &answer, const QVector<mdns_record_t> &additional)
+{
+    QByteArray packet(MAX_PACKET_SIZE, Qt::Uninitialized);
+    void *buffer = packet.data();
+    const size_t capacity = packet.size();
+
+    struct mdns_header_t *header = (struct mdns_header_t *)buffer;
+    header->query_id = 0;
+    header->flags = htons(0x8400);
+    header->questions = 0;
+    header->answer_rrs = htons(1);
+    header->authority_rrs = 0;
+    header->additional_rrs = htons(mdns_answer_get_record_count(additional.constData(), additional.size()));
+
+    mdns_string_table_t string_table = {{0}, 0, 0};
+    void *data = MDNS_POINTER_OFFSET(buffer, sizeof(struct mdns_header_t));
+
+    mdns_record_t record = answer;
+    mdns_record_update_rclass_ttl(&record, MDNS_CLASS_IN, ANSWER_TTL);
+    data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
+    for (const mdns_record_t &additionalRecord : additional) {
+        record = additionalRecord;
+        mdns_record_update_rclass_ttl(&record, MDNS_CLASS_IN, ANSWER_TTL);
+        data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
+    }
+    data = mdns_answer_add_txt_record(buffer, capacity, data, additional.constData(), additional.size(), MDNS_CLASS_IN, ANSWER_TTL, &string_table);
+    if (!data) {
+        return {};
+    }
+    packet.truncate(MDNS_POINTER_DIFF(data, buffer));
+    return packet;
+}
+
+static QVector<PreparedAnswer> prepareAnswers(const Announcer::AnnouncedInfo &self, const struct sockaddr *fromAddress)
+{
+    QVector<mdns_record_t> txtRecords;
+    for (auto txtIterator = self.txtRecords.cbegin(); txtIterator != self.txtRecords.cend(); txtIterator++) {
+        txtRecords.append(createMdnsRecord(self, MDNS_RECORDTYPE_TXT, nullptr, txtIterator));
+    }
+
+    QVector<PreparedAnswer> answers(ANSWER_KIND_COUNT);
+    const auto prepare = [&answers](AnswerKind kind, const mdns_record_t &answer, const QVector<mdns_record_t> &additional) {
+        PreparedAnswer &prepared = answers[kind];
+        prepared.valid = true;
+        prepared.answer = answer;
+        prepared.additional = additional;
+        prepared.multicastPacket = serializeMulticastAnswer(answer, additional);
+    };
+
+    // The PTR query was for the DNS-SD domain, answer with a PTR record for the service type we advertise (RFC 6763 section 9)
+    mdns_record_t serviceTypeRecord = createMdnsRecord(self, MDNS_RECORDTYPE_PTR);
+    serviceTypeRecord.name = createMdnsString(dnsSdName);
+    serviceTypeRecord.data.ptr.name = createMdnsString(self.serviceType);
+    prepare(DnsSdPtrAnswer, serviceTypeRecord, {});
+
+    QVector<mdns_record_t> addressRecords;
+    if (!self.addressesV4.empty()) {
+        addressRecords.append(createMdnsRecord(self, MDNS_RECORDTYPE_A, fromAddress));
+    }
+    if (!self.addressesV6.empty()) {
+        addressRecords.append(createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, fromAddress));
+    }
+
+    // The PTR query was for our service, answer a PTR record reverse mapping the queried service name
+    // to our service instance name and add additional records containing the SRV record mapping the
+    // service instance name to our qualified hostname and port, as well as any IPv4/IPv6 and TXT records
+    prepare(ServicePtrAnswer, createMdnsRecord(self, MDNS_RECORDTYPE_PTR), QVector<mdns_record_t>{createMdnsRecord(self, MDNS_RECORDTYPE_SRV)} + addressRecords + txtRecords);
+
+    // The SRV query was for our service instance, answer a SRV record mapping the service
+    // instance name to our qualified hostname (typically "<hostname>.local.") and port, as
+    // well as any IPv4/IPv6 address for the hostname as A/AAAA records and TXT records
+    prepare(ServiceSrvAnswer, createMdnsRecord(self, MDNS_RECORDTYPE_SRV), addressRecords + txtRecords);
+
+    // The A or AAAA query was for our qualified hostname, answer with a record mapping the hostname to
+    // an address, as well as a record for the other protocol and TXT records
+    if (!self.addressesV4.empty()) {
+        QVector<mdns_record_t> additional;
+        if (!self.addressesV6.empty()) {
+            additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, fromAddress));
+        }
+        prepare(HostAAnswer, createMdnsRecord(self, MDNS_RECORDTYPE_A, fromAddress), additional + txtRecords);
+    }
+    if (!self.addressesV6.empty()) {
+        QVector<mdns_record_t> additional;
+        if (!self.addressesV4.empty()) {
+            additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_A, fromAddress));
+        }
+        prepare(HostAaaaAnswer, createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, fromAddress), additional + txtRecords);
+    }
+
+    return answers;
+}
+
+/**
+ * A record reduced to what identifies it: type, owner name and RDATA
+ */
+struct RecordKey {
+    uint16_t type;
+    QByteArray name;
+    QByteArray data;
+
+    bool operator==(const RecordKey &other) const
+    {
+        return type == other.type && name == other.name && data == other.data;
+    }
+};
+
+static QByteArray srvRecordData(uint16_t port, const mdns_string_t &target)
+{
+    return QByteArray::number(port) + ' ' + QByteArray(target.str, target.length);
+}
+
+static RecordKey recordKey(const mdns_record_t &record)
+{
+    RecordKey key{(uint16_t)record.type, QByteArray(record.name.str, record.name.length), {}};
+    switch (record.type) {
+    case MDNS_RECORDTYPE_PTR:
+        key.data = QByteArray(record.data.ptr.name.str, record.data.ptr.name.length);
+        break;
+    case MDNS_RECORDTYPE_SRV:
+        key.data = srvRecordData(record.data.srv.port, record.data.srv.name);
+        break;
+    case MDNS_RECORDTYPE_A:
+        key.data = QByteArray((const char *)&record.data.a.addr.sin_addr, sizeof(record.data.a.addr.sin_addr));
+        break;
+    case MDNS_RECORDTYPE_AAAA:
+        key.data = QByteArray((const char *)&record.data.aaaa.addr.sin6_addr, sizeof(record.data.aaaa.addr.sin6_addr));
+        break;
+    default:
+        break;
+    }
+    return key;
+}
+
+/**
+ * The questions in one incoming packet, and the answers the querier already knows
+ */
+struct ReceivedQuery {
+    struct Question {
+        AnswerKind kind;
+        uint16_t queryId;
+        uint16_t recordType;
+        bool unicast;
+        QByteArray name;
+    };
+
+    const Announcer::AnnouncedInfo *self;
+    QVector<Question> questions;
+    QVector<RecordKey> knownAnswers;
+    struct sockaddr_storage from;
+    size_t fromLength = 0;
+};
+
+// Callback collecting the questions and known answers of a packet incoming on service sockets
 static int service_callback(int sock,
                             const struct sockaddr *from,
                             size_t addrlen,
@@ -379,206 +679,167 @@ static int service_callback(int sock,
                             size_t record_length,
                             void *user_data)
 {
-    Q_UNUSED(ttl);
+    Q_UNUSED(sock);
     Q_UNUSED(name_length);
-    Q_UNUSED(record_offset);
-    Q_UNUSED(record_length);
-    static char sendbuffer[2024];
 
-    const Announcer::AnnouncedInfo &self = *((Announcer::AnnouncedInfo *)user_data);
+    ReceivedQuery &query = *((ReceivedQuery *)user_data);
+    const Announcer::AnnouncedInfo &self = *query.self;
 
-    if (entry_type != MDNS_ENTRYTYPE_QUESTION) {
-        return 0;
-    }
-
-    static char nameBuffer[256];
+    char nameBuffer[256];
     mdns_string_t nameMdnsString = mdns_string_extract(data, size, &name_offset, nameBuffer, sizeof(nameBuffer));
     QByteArray name = QByteArray(nameMdnsString.str, nameMdnsString.length);
 
-    int ret = 0;
+    if (entry_type == MDNS_ENTRYTYPE_ANSWER) {
+        // Known-answer suppression (RFC 6762 section 7.1): the querier lists the records it has cached,
+        // there is no need to send one it still holds for at least half of its lifetime. Only a record with the same
+        // data counts, a querier may still hold our old address or port.
+        if (ttl < ANSWER_TTL / 2) {
+            return 0;
+        }
+        if (name != dnsSdName && name != self.serviceType && name != self.serviceInstance && name != self.hostname) {
+            return 0;
+        }
+        RecordKey known{record_type, name, {}};
+        char targetBuffer[256];
+        switch (record_type) {
+        case MDNS_RECORDTYPE_PTR: {
+            const mdns_string_t target = mdns_record_parse_ptr(data, size, record_offset, record_length, targetBuffer, sizeof(targetBuffer));
+            known.data = QByteArray(target.str, target.length);
+        } break;
+        case MDNS_RECORDTYPE_SRV: {
+            const mdns_record_srv_t srv = mdns_record_parse_srv(data, size, record_offset, record_length, targetBuffer, sizeof(targetBuffer));
+            known.data = srvRecordData(srv.port, srv.name);
+        } break;
+        case MDNS_RECORDTYPE_A: {
+            sockaddr_in addr;
+            mdns_record_parse_a(data, size, record_offset, record_length, &addr);
+            known.data = QByteArray((const char *)&addr.sin_addr, sizeof(addr.sin_addr));
+        } break;
+        case MDNS_RECORDTYPE_AAAA: {
+            sockaddr_in6 addr;
+            mdns_record_parse_aaaa(data, size, record_offset, record_length, &addr);
+            known.data = QByteArray((const char *)&addr.sin6_addr, sizeof(addr.sin6_addr));
+        } break;
+        default:
+            return 0;
+        }
+        query.knownAnswers.append(known);
+        return 0;
+    }
 
+    if (entry_type != MDNS_ENTRYTYPE_QUESTION) {
+        return 0;
+    }
+
+    AnswerKind kind;
     if (name == dnsSdName) {
-        if ((record_type == MDNS_RECORDTYPE_PTR) || (record_type == MDNS_RECORDTYPE_ANY)) {
-            // The PTR query was for the DNS-SD domain, send answer with a PTR record for the service name we advertise.
-
-            mdns_record_t answer = createMdnsRecord(self, MDNS_RECORDTYPE_PTR);
-
-            uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-            if (unicast) {
-                ret = mdns_query_answer_unicast(sock,
-                                                from,
-                                                addrlen,
-                                                sendbuffer,
-                                                sizeof(sendbuffer),
-                                                query_id,
-                                                (mdns_record_type_t)record_type,
-                                                nameMdnsString.str,
-                                                nameMdnsString.length,
-                                                answer,
-                                                nullptr,
-                                                0,
-                                                nullptr,
-                                                0);
-            } else {
-                ret = mdns_query_answer_multicast(sock, sendbuffer, sizeof(sendbuffer), answer, nullptr, 0, nullptr, 0);
-            }
+        if ((record_type != MDNS_RECORDTYPE_PTR) && (record_type != MDNS_RECORDTYPE_ANY)) {
+            return 0;
         }
+        kind = DnsSdPtrAnswer;
     } else if (name == self.serviceType) {
-        if ((record_type == MDNS_RECORDTYPE_PTR) || (record_type == MDNS_RECORDTYPE_ANY)) {
-            // The PTR query was for our service, answer a PTR record reverse mapping the queried service name
-            // to our service instance name and add additional records containing the SRV record mapping the
-            // service instance name to our qualified hostname and port, as well as any IPv4/IPv6 and TXT records
-
-            mdns_record_t answer = createMdnsRecord(self, MDNS_RECORDTYPE_PTR);
-
-            QVector<mdns_record_t> additional;
-            additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_SRV));
-            if (!self.addressesV4.empty()) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_A, from));
-            }
-            if (!self.addressesV6.empty()) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, from));
-            }
-
-            for (auto txtIterator = self.txtRecords.cbegin(); txtIterator != self.txtRecords.cend(); txtIterator++) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_TXT, nullptr, txtIterator));
-            }
-
-            uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-            if (unicast) {
-                ret = mdns_query_answer_unicast(sock,
-                                                from,
-                                                addrlen,
-                                                sendbuffer,
-                                                sizeof(sendbuffer),
-                                                query_id,
-                                                (mdns_record_type_t)record_type,
-                                                nameMdnsString.str,
-                                                nameMdnsString.length,
-                                                answer,
-                                                nullptr,
-                                                0,
-                                                additional.constData(),
-                                                additional.length());
-            } else {
-                ret = mdns_query_answer_multicast(sock, sendbuffer, sizeof(sendbuffer), answer, nullptr, 0, additional.constData(), additional.length());
-            }
+        if ((record_type != MDNS_RECORDTYPE_PTR) && (record_type != MDNS_RECORDTYPE_ANY)) {
+            return 0;
         }
+        kind = ServicePtrAnswer;
     } else if (name == self.serviceInstance) {
-        if ((record_type == MDNS_RECORDTYPE_SRV) || (record_type == MDNS_RECORDTYPE_ANY)) {
-            // The SRV query was for our service instance, answer a SRV record mapping the service
-            // instance name to our qualified hostname (typically "<hostname>.local.") and port, as
-            // well as any IPv4/IPv6 address for the hostname as A/AAAA records and TXT records
-
-            mdns_record_t answer = createMdnsRecord(self, MDNS_RECORDTYPE_SRV);
-
-            QVector<mdns_record_t> additional;
-            if (!self.addressesV4.empty()) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_A, from));
-            }
-            if (!self.addressesV6.empty()) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, from));
-            }
-
-            for (auto txtIterator = self.txtRecords.cbegin(); txtIterator != self.txtRecords.cend(); txtIterator++) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_TXT, nullptr, txtIterator));
-            }
-
-            uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-            if (unicast) {
-                ret = mdns_query_answer_unicast(sock,
-                                                from,
-                                                addrlen,
-                                                sendbuffer,
-                                                sizeof(sendbuffer),
-                                                query_id,
-                                                (mdns_record_type_t)record_type,
-                                                nameMdnsString.str,
-                                                nameMdnsString.length,
-                                                answer,
-                                                nullptr,
-                                                0,
-                                                additional.constData(),
-                                                additional.length());
-            } else {
-                ret = mdns_query_answer_multicast(sock, sendbuffer, sizeof(sendbuffer), answer, nullptr, 0, additional.constData(), additional.length());
-            }
+        if ((record_type != MDNS_RECORDTYPE_SRV) && (record_type != MDNS_RECORDTYPE_ANY)) {
+            return 0;
         }
+        kind = ServiceSrvAnswer;
     } else if (name == self.hostname) {
         if (((record_type == MDNS_RECORDTYPE_A) || (record_type == MDNS_RECORDTYPE_ANY)) && !self.addressesV4.empty()) {
-            // The A query was for our qualified hostname and we have an IPv4 address, answer with an A
-            // record mapping the hostname to an IPv4 address, as well as an AAAA record and TXT records
-
-            mdns_record_t answer = createMdnsRecord(self, MDNS_RECORDTYPE_A, from);
-
-            QVector<mdns_record_t> additional;
-            if (!self.addressesV6.empty()) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, from));
-            }
+            kind = HostAAnswer;
+        } else if (((record_type == MDNS_RECORDTYPE_AAAA) || (record_type == MDNS_RECORDTYPE_ANY)) && !self.addressesV6.empty()) {
+            kind = HostAaaaAnswer;
+        } else {
+            return 0;
+        }
+    } else {
+        // Request is not for me
+        return 0;
+    }
 
-            for (auto txtIterator = self.txtRecords.cbegin(); txtIterator != self.txtRecords.cend(); txtIterator++) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_TXT, nullptr, txtIterator));
-            }
+    if (query.fromLength == 0 && addrlen <= sizeof(query.from)) {
+        memcpy(&query.from, from, addrlen);
+        query.fromLength = addrlen;
+    }
+    query.questions.append({kind, query_id, record_type, (rclass & MDNS_UNICAST_RESPONSE) != 0, name});
+    return 0;
+}
 
-            uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-            if (unicast) {
-                ret = mdns_query_answer_unicast(sock,
-                                                from,
-                                                addrlen,
-                                                sendbuffer,
-                                                sizeof(sendbuffer),
-                                                query_id,
-                                                (mdns_record_type_t)record_type,
-                                                nameMdnsString.str,
-                                                nameMdnsString.length,
-                                                answer,
-                                                nullptr,
-                                                0,
-                                                additional.constData(),
-                                                additional.length());
-            } else {
-                ret = mdns_query_answer_multicast(sock, sendbuffer, sizeof(sendbuffer), answer, nullptr, 0, additional.constData(), additional.length());
-            }
-        } else if (((record_type == MDNS_RECORDTYPE_AAAA) || (record_type == MDNS_RECORDTYPE_ANY)) && !self.addressesV6.empty()) {
-            // The AAAA query was for our qualified hostname and we have an IPv6 address, answer with an AAAA
-            // record mapping the hostname to an IPv4 address, as well as an A record and TXT records
+void Announcer::receiveQueries(int socket)
+{
+    ReceivedQuery query;
+    query.self = &self;
+    mdns_socket_listen(socket, receiveBuffer.data(), receiveBuffer.size(), service_callback, &query);
+    if (query.questions.isEmpty() || query.fromLength == 0) {
+        return;
+    }
 
-            mdns_record_t answer = createMdnsRecord(self, MDNS_RECORDTYPE_AAAA, from);
+    AnswerCache &cache = answerCache();
+    const struct sockaddr *from = (const struct sockaddr *)&query.from;
+    // The set of answers whose A record is on the querier's network
+    const quint32 address = self.addressesV4.empty() ? 0 : findBestAddressMatchV4(self.addressesV4, from).toIPv4Address();
+    const auto answerSet = cache.answers.constFind(address);
+    if (answerSet == cache.answers.cend()) {
+        return;
+    }
 
-            QVector<mdns_record_t> additional;
-            if (!self.addressesV4.empty()) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_A, from));
-            }
+    for (const ReceivedQuery::Question &question : std::as_const(query.questions)) {
+        const PreparedAnswer &prepared = (*answerSet)[question.kind];
+        if (!prepared.valid || query.knownAnswers.contains(recordKey(prepared.answer))) {
+            continue;
+        }
 
-            for (auto txtIterator = self.txtRecords.cbegin(); txtIterator != self.txtRecords.cend(); txtIterator++) {
-                additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_TXT, nullptr, txtIterator));
+        int ret;
+        if (question.unicast) {
+            ret = mdns_query_answer_unicast(socket,
+                                            from,
+                                            query.fromLength,
+                                            sendBuffer.data(),
+                                            sendBuffer.size(),
+                                            question.queryId,
+                                            (mdns_record_type_t)question.recordType,
+                                            question.name.constData(),
+                                            question.name.length(),
+                                            prepared.answer,
+                                            nullptr,
+                                            0,
+                                            prepared.additional.constData(),
+                                            prepared.additional.length());
+        } else {
+            // Everybody on the network got the last multicast of this answer as well
+            const MulticastKey key{socket, question.kind, address};
+            const qint64 now = cache.clock.elapsed();
+            auto lastMulticast = cache.lastMulticast.constFind(key);
+            if (lastMulticast != cache.lastMulticast.cend() && now - *lastMulticast < MIN_MILLIS_BETWEEN_MULTICASTS) {
+                continue;
             }
+            cache.lastMulticast[key] = now;
+            ret = prepared.multicastPacket.isEmpty() ? -1 : mdns_multicast_send(socket, prepared.multicastPacket.constData(), prepared.multicastPacket.size());
+        }
+        if (ret < 0) {
+            qCWarning(KDECONNECT_CORE) << "Error sending MDNS query response";
+        }
+    }
+}
 
-            uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-            if (unicast) {
-                ret = mdns_query_answer_unicast(sock,
-                                                from,
-                                                addrlen,
-                                                sendbuffer,
-                                                sizeof(sendbuffer),
-                                                query_id,
-                                                (mdns_record_type_t)record_type,
-                                                nameMdnsString.str,
-                                                nameMdnsString.length,
-                                                answer,
-                                                nullptr,
-                                                0,
-                                                additional.constData(),
-                                                additional.length());
-            } else {
-                ret = mdns_query_answer_multicast(sock, sendbuffer, sizeof(sendbuffer), answer, nullptr, 0, additional.constData(), additional.length());
-            }
+Announcer::AnswerCache &Announcer::answerCache()
+{
+    if (!preparedAnswers) {
+        preparedAnswers.reset(new AnswerCache);
+        preparedAnswers->clock.start();
+        if (self.addressesV4.empty()) {
+            preparedAnswers->answers[0] = prepareAnswers(self, nullptr);
+        }
+        for (const QHostAddress &address : std::as_const(self.addressesV4)) {
+            // A source address on the same network makes createMdnsRecord() pick this address for the A record
+            const sockaddr_in from = qHostAddressToSockaddr(address);
+            preparedAnswers->answers[address.toIPv4Address()] = prepareAnswers(self, (const struct sockaddr *)&from);
         }
-    } // else request is not for me
-    if (ret < 0) {
-        qCWarning(KDECONNECT_CORE) << "Error sending MDNS query response";
     }
-    return ret;
+    return *preparedAnswers;
 }
 
 // Open sockets to listen to incoming mDNS queries on port 5353
@@ -587,8 +848,7 @@ static int service_callback(int sock,
 int Announcer::listenForQueries()
 {
     auto callback = [this](QSocketDescriptor socket) {
-        static char buffer[2048];
-        mdns_socket_listen(socket, buffer, sizeof(buffer), service_callback, &self);
+        receiveQueries(socket);
     };
 
     int numSockets = 0;
@@ -644,11 +904,23 @@ Announcer::Announcer(const QString &instanceName, const QString &serviceType, ui
     self.serviceInstance = instanceName.toLatin1() + '.' + self.serviceType;
     self.hostname = QHostInfo::localHostName().toLatin1() + ".local.";
     self.port = port;
+    receiveBuffer.resize(MAX_PACKET_SIZE);
+    sendBuffer.resize(MAX_PACKET_SIZE);
     detectHostAddresses();
 }
 
+Announcer::~Announcer() = default;
+
+void Announcer::putTxtRecord(const QString &key, const QString &value)
+{
+    self.txtRecords[key.toLatin1()] = value.toLatin1();
+    preparedAnswers.reset();
+}
+
 void Announcer::detectHostAddresses()
 {
+    const QVector<QHostAddress> previousAddressesV4 = self.addressesV4;
+    const QVector<QHostAddress> previousAddressesV6 = self.addressesV6;
     self.addressesV4.clear();
     self.addressesV6.clear();
     for (const QNetworkInterface &iface : QNetworkInterface::allInterfaces()) {
@@ -665,6 +937,10 @@ void Announcer::detectHostAddresses()
             }
         }
     }
+
+    if (self.addressesV4 != previousAddressesV4 || self.addressesV6 != previousAddressesV6) {
+        preparedAnswers.reset();
+    }
 }
 
 void Announcer::startAnnouncing()
@@ -693,34 +969,27 @@ void Announcer::stopListeningForQueries()
 
 void Announcer::sendMulticastAnnounce(bool isGoodbye)
 {
-    mdns_record_t ptr_record = createMdnsRecord(self, MDNS_RECORDTYPE_PTR);
-
-    QVector<mdns_record_t> additional;
-    additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_SRV));
-    if (!self.addressesV4.empty()) {
-        additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_A));
-    }
-    if (!self.addressesV6.empty()) {
-        additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_AAAA));
-    }
-
-    for (auto txtIterator = self.txtRecords.cbegin(); txtIterator != self.txtRecords.cend(); txtIterator++) {
-        additional.append(createMdnsRecord(self, MDNS_RECORDTYPE_TXT, nullptr, txtIterator));
+    // Announcements don't go to a particular network, they carry the A record of our first address
+    const QVector<PreparedAnswer> answerSet = answerCache().answers.value(self.addressesV4.empty() ? 0 : self.addressesV4.first().toIPv4Address());
+    if (answerSet.isEmpty()) {
+        return;
     }
+    const PreparedAnswer &prepared = answerSet[ServicePtrAnswer];
+    const mdns_record_t &ptr_record = prepared.answer;
+    const QVector<mdns_record_t> &additional = prepared.additional;
 
-    static char buffer[2048];
     if (isGoodbye) {
         qCDebug(KDECONNECT_CORE) << "Sending goodbye";
         if (socketNotifier)
-            mdns_goodbye_multicast(socketNotifier->socket(), buffer, sizeof(buffer), ptr_record, nullptr, 0, additional.constData(), additional.length());
+            mdns_goodbye_multicast(socketNotifier->socket(), sendBuffer.data(), sendBuffer.size(), ptr_record, nullptr, 0, additional.constData(), additional.length());
         if (socketNotifierV6)
-            mdns_goodbye_multicast(socketNotifierV6->socket(), buffer, sizeof(buffer), ptr_record, nullptr, 0, additional.constData(), additional.length());
+            mdns_goodbye_multicast(socketNotifierV6->socket(), sendBuffer.data(), sendBuffer.size(), ptr_record, nullptr, 0, additional.constData(), additional.length());
     } else {
         qCDebug(KDECONNECT_CORE) << "Sending announce";
         if (socketNotifier)
-            mdns_announce_multicast(socketNotifier->socket(), buffer, sizeof(buffer), ptr_record, nullptr, 0, additional.constData(), additional.length());
+            mdns_announce_multicast(socketNotifier->socket(), sendBuffer.data(), sendBuffer.size(), ptr_record, nullptr, 0, additional.constData(), additional.length());
         if (socketNotifierV6)
-            mdns_announce_multicast(socketNotifierV6->socket(), buffer, sizeof(buffer), ptr_record, nullptr, 0, additional.constData(), additional.length());
+            mdns_announce_multicast(socketNotifierV6->socket(), sendBuffer.data(), sendBuffer.size(), ptr_record, nullptr, 0, additional.constData(), additional.length());
     }
 }
 
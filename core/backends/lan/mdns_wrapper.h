@@ -7,11 +7,16 @@
 #ifndef KDECONNECT_MDNS_WRAPPER_H
 #define KDECONNECT_MDNS_WRAPPER_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QHostAddress>
 #include <QMap>
 #include <QSocketNotifier>
 #include <QString>
+#include <QTimer>
 #include <QVector>
+#include <limits>
+#include <memory>
 
 #include "kdeconnectcore_export.h"
 
@@ -28,11 +33,14 @@ class KDECONNECTCORE_EXPORT Discoverer : public QObject
 public:
     struct MdnsService {
         QString name; // The instance-name part in "<instance-name>._<service-type>._tcp.local."
-        uint16_t port;
+        uint16_t port = 0;
         QHostAddress address; // An IPv4 address (IPv6 addresses are ignored)
         QMap<QString, QString> txtRecords;
+        uint32_t ttl = std::numeric_limits<uint32_t>::max(); // The lowest TTL of the received records in seconds, 0 for a goodbye
     };
 
+    Discoverer();
+
     // serviceType must be of the form "_<service-type>._<tcp/udp>.local"
     void startDiscovering(const QString &serviceType);
     void stopDiscovering();
@@ -40,13 +48,29 @@ public:
     void sendQuery(const QString &serviceType);
 
 Q_SIGNALS:
+    // Only emitted for services that are new, came back after expiring, or changed
     void serviceFound(const MdnsWrapper::Discoverer::MdnsService &service);
 
 private:
     int listenForQueryResponses();
     void stopListeningForQueryResponses();
 
+    void serviceReceived(const MdnsService &service);
+    void emitPendingServices();
+
     QVector<QSocketNotifier *> responseSocketNotifiers;
+
+    struct CachedService {
+        MdnsService service;
+        QVector<QHostAddress> addresses; // Every address the service was seen at
+        qint64 expiresAt;
+    };
+    // Services already reported, by instance name. Answers without an address are kept as well, so their repeats are dropped too.
+    QHash<QString, CachedService> discoveredServices;
+    // Services to report once the coalescing window ends, the same answer often arrives on several sockets at once
+    QHash<QString, MdnsService> pendingServices;
+    QTimer coalesceTimer;
+    QElapsedTimer clock;
 };
 
 class KDECONNECTCORE_EXPORT Announcer : public QObject
@@ -66,11 +90,9 @@ public:
 
     // serviceType must be of the form "_<service-type>._<tcp/udp>.local"
     Announcer(const QString &instanceName, const QString &serviceType, uint16_t port);
+    ~Announcer() override;
 
-    void putTxtRecord(const QString &key, const QString &value)
-    {
-        self.txtRecords[key.toLatin1()] = value.toLatin1();
-    }
+    void putTxtRecord(const QString &key, const QString &value);
 
     void startAnnouncing();
     void stopAnnouncing();
@@ -85,12 +107,20 @@ public Q_SLOTS:
     }
 
 private:
+    struct AnswerCache;
+
     int listenForQueries();
     void stopListeningForQueries();
+    void receiveQueries(int socket);
+    AnswerCache &answerCache();
 
     void detectHostAddresses();
 
     AnnouncedInfo self;
+    // Our answers to every query, prepared from self and dropped when it changes
+    std::unique_ptr<AnswerCache> preparedAnswers;
+    QByteArray receiveBuffer;
+    QByteArray sendBuffer;
 
     QSocketNotifier *socketNotifier = nullptr;
     QSocketNotifier *socketNotifierV6 = nullptr;
@@ -0,0 +1,37 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "portallocator.h"
+
+#include <QSet>
+
+static QSet<quint16> s_heldPorts;
+// Start after the port handed out last, the ones before it are likely to still be in use
+static quint16 s_nextPort = 0;
+
+quint16 PortAllocator::listen(QTcpServer *server, quint16 minPort, quint16 maxPort)
+{
+    const int rangeSize = maxPort - minPort + 1;
+    const int start = (s_nextPort >= minPort && s_nextPort <= maxPort) ? s_nextPort - minPort : 0;
+
+    for (int i = 0; i < rangeSize; i++) {
+        const quint16 port = minPort + (start + i) % rangeSize;
+        if (s_heldPorts.contains(port)) {
+            continue;
+        }
+        if (server->listen(QHostAddress::Any, port)) {
+            s_heldPorts.insert(port);
+            s_nextPort = port + 1;
+            return port;
+        }
+    }
+    return 0;
+}
+
+void PortAllocator::release(quint16 port)
+{
+    s_heldPorts.remove(port);
+}
@@ -0,0 +1,34 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef PORTALLOCATOR_H
+#define PORTALLOCATOR_H
+
+#include <QTcpServer>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * Hands out listening ports from a range, remembering which ones our own servers already hold.
+ *
+ * Concurrent uploads no longer try to bind every port that another upload of this daemon is using,
+ * only ports held by other processes can still make a listen() fail.
+ */
+class KDECONNECTCORE_EXPORT PortAllocator
+{
+public:
+    /**
+     * Makes @p server listen on a free port between @p minPort and @p maxPort.
+     * Returns the port, or 0 if every port in the range is taken.
+     */
+    static quint16 listen(QTcpServer *server, quint16 minPort, quint16 maxPort);
+    /**
+     * To be called once the server that got @p port stops listening
+     */
+    static void release(quint16 port);
+};
+
+#endif // PORTALLOCATOR_H
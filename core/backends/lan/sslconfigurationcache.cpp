@@ -0,0 +1,79 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "sslconfigurationcache.h"
+
+#include <QSslCertificate>
+#include <QSslKey>
+
+#include "core_debug.h"
+#include "kdeconnectconfig.h"
+
+SslConfigurationCache &SslConfigurationCache::instance()
+{
+    static SslConfigurationCache cache;
+    return cache;
+}
+
+QSslConfiguration SslConfigurationCache::configuration(const QString &deviceId, bool isDeviceTrusted)
+{
+    checkRevisions();
+    if (!isDeviceTrusted) {
+        return baseConfiguration();
+    }
+
+    auto it = m_trustedConfigurations.constFind(deviceId);
+    if (it != m_trustedConfigurations.constEnd()) {
+        return *it;
+    }
+
+    QSslConfiguration sslConfig = baseConfiguration();
+    sslConfig.setCaCertificates({KdeConnectConfig::instance().getTrustedDeviceCertificate(deviceId)});
+    sslConfig.setPeerVerifyMode(QSslSocket::VerifyPeer);
+    // Sessions are only kept for devices whose certificate we verify, resuming one skips that check
+    sslConfig.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    m_trustedConfigurations.insert(deviceId, sslConfig);
+    return sslConfig;
+}
+
+void SslConfigurationCache::setSessionTicket(const QString &deviceId, const QByteArray &ticket)
+{
+    checkRevisions();
+
+    auto it = m_trustedConfigurations.find(deviceId);
+    if (it != m_trustedConfigurations.end() && it->sessionTicket() != ticket) {
+        it->setSessionTicket(ticket);
+    }
+}
+
+void SslConfigurationCache::checkRevisions()
+{
+    // Every configuration carries our certificate and key
+    const quint64 identityRevision = KdeConnectConfig::instance().identityRevision();
+    if (identityRevision != m_identityRevision) {
+        m_baseConfiguration = QSslConfiguration();
+        m_trustedConfigurations.clear();
+        m_identityRevision = identityRevision;
+    }
+
+    // Also forgets the sessions of devices that are no longer trusted
+    const quint64 revision = KdeConnectConfig::instance().trustedDevicesRevision();
+    if (revision != m_trustedDevicesRevision) {
+        m_trustedConfigurations.clear();
+        m_trustedDevicesRevision = revision;
+    }
+}
+
+QSslConfiguration SslConfigurationCache::baseConfiguration()
+{
+    if (m_baseConfiguration.localCertificate().isNull()) {
+        qCDebug(KDECONNECT_CORE) << "Building the SSL configuration";
+        m_baseConfiguration.setLocalCertificate(KdeConnectConfig::instance().certificate());
+        m_baseConfiguration.setPrivateKey(KdeConnectConfig::instance().privateKey());
+        m_baseConfiguration.setPeerVerifyMode(QSslSocket::QueryPeer);
+    }
+    return m_baseConfiguration;
+}
@@ -0,0 +1,49 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef SSLCONFIGURATIONCACHE_H
+#define SSLCONFIGURATIONCACHE_H
+
+#include <QHash>
+#include <QSslConfiguration>
+#include <QString>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * The SSL configurations handed to every link and payload socket.
+ *
+ * The local certificate and private key rarely change while running, and the certificate of a trusted
+ * device only changes when it gets paired again, so configurations are built once and then shared.
+ * QSslConfiguration is implicitly shared, setting one on a socket only copies a pointer.
+ *
+ * Cached configurations are dropped whenever KdeConnectConfig reports a change to our identity or to the
+ * trusted devices.
+ *
+ * Configurations for trusted devices also carry the last TLS session ticket that device gave us, so the
+ * next connection where we are the TLS client can resume the session instead of doing a full handshake.
+ */
+class KDECONNECTCORE_EXPORT SslConfigurationCache
+{
+public:
+    static SslConfigurationCache &instance();
+
+    QSslConfiguration configuration(const QString &deviceId, bool isDeviceTrusted);
+    void setSessionTicket(const QString &deviceId, const QByteArray &ticket);
+
+private:
+    SslConfigurationCache() = default;
+
+    QSslConfiguration baseConfiguration();
+    void checkRevisions();
+
+    QSslConfiguration m_baseConfiguration;
+    QHash<QString, QSslConfiguration> m_trustedConfigurations;
+    quint64 m_trustedDevicesRevision = 0;
+    quint64 m_identityRevision = 0;
+};
+
+#endif // SSLCONFIGURATIONCACHE_H
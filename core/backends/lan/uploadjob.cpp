@@ -8,9 +8,17 @@
 
 #include <KLocalizedString>
 
+#include <QFileDevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
 #include "core_debug.h"
 #include "kdeconnectconfig.h"
 #include "lanlinkprovider.h"
+#include "lanpayloadstream.h"
+#include "lanstripedpayload.h"
+#include "payloadhasher.h"
 #include <daemon.h>
 
 UploadJob::UploadJob(const NetworkPacket &networkPacket)
@@ -18,13 +26,69 @@ UploadJob::UploadJob(const NetworkPacket &networkPacket)
     , m_networkPacket(networkPacket)
     , m_input(networkPacket.payload())
     , m_socket(nullptr)
+    , m_sslSocket(nullptr)
+    , bytesUploaded(0)
+    , m_bytesQueued(0)
+    , m_highWaterMark(DEFAULT_HIGH_WATER_MARK)
+    , m_inputExhausted(false)
+    , m_streamed(false)
+    , m_sendLimit(-1)
+    , m_rangeOffset(-1)
+    , m_rangeLength(0)
+    , m_resumable(false)
+    , m_resumeOffset(0)
+    , m_checksumEnabled(false)
+    , m_hasher(nullptr)
+    , m_hashing(false)
+    , m_checksumWritten(false)
+    , m_mappedInput(nullptr)
+    , m_mappedSize(0)
 {
 }
 
-void UploadJob::setSocket(QSslSocket *socket)
+void UploadJob::setSocket(QIODevice *socket)
 {
     m_socket = socket;
-    m_socket->setParent(this);
+    m_sslSocket = qobject_cast<QSslSocket *>(socket);
+    if (!m_streamed) {
+        m_socket->setParent(this);
+    }
+}
+
+void UploadJob::setStreamed(bool streamed)
+{
+    m_streamed = streamed && m_networkPacket.payloadSize() >= 0;
+}
+
+bool UploadJob::isStreamed() const
+{
+    return m_streamed;
+}
+
+void UploadJob::setResumable(bool resumable)
+{
+    m_resumable = resumable;
+}
+
+void UploadJob::setChecksumEnabled(bool enabled)
+{
+    m_checksumEnabled = enabled;
+}
+
+QByteArray UploadJob::checksum() const
+{
+    return m_checksum;
+}
+
+void UploadJob::setRange(qint64 offset, qint64 length)
+{
+    m_rangeOffset = offset;
+    m_rangeLength = length;
+}
+
+void UploadJob::setHighWaterMark(qint64 bytes)
+{
+    m_highWaterMark = qMax(bytes, CHUNK_SIZE);
 }
 
 void UploadJob::start()
@@ -40,46 +104,261 @@ void UploadJob::start()
     }
 
     connect(m_input.data(), &QIODevice::aboutToClose, this, &UploadJob::aboutToClose);
+    if (!m_sslSocket) {
+        // Payload sockets report errors to CompositeUploadJob, other devices only tell us they are done
+        connect(m_socket, &QIODevice::readChannelFinished, this, &UploadJob::socketClosed);
+    }
+
+    if (m_resumable) {
+        // The receiver tells us where to start, it might have part of the file from an earlier attempt
+        connect(m_socket, &QIODevice::readyRead, this, &UploadJob::readPayloadRequest);
+        if (m_sslSocket) {
+            connect(m_sslSocket, &QAbstractSocket::disconnected, this, &UploadJob::stop);
+        }
+        readPayloadRequest();
+        return;
+    }
+
+    startSending();
+}
+
+void UploadJob::readPayloadRequest()
+{
+    if (!m_socket->canReadLine()) {
+        if (m_socket->bytesAvailable() > MAX_PAYLOAD_REQUEST_SIZE) {
+            qCWarning(KDECONNECT_CORE) << "UploadJob: payload request too long, giving up";
+            m_input->close();
+        }
+        return;
+    }
+
+    disconnect(m_socket, &QIODevice::readyRead, this, &UploadJob::readPayloadRequest);
+    if (m_sslSocket) {
+        disconnect(m_sslSocket, &QAbstractSocket::disconnected, this, &UploadJob::stop);
+    }
 
-    bytesUploaded = 0;
+    const QJsonObject request = QJsonDocument::fromJson(m_socket->readLine()).object();
+    const qint64 offset = request.value(QStringLiteral("offset")).toInteger();
+    if (offset < 0 || offset > m_networkPacket.payloadSize()) {
+        qCWarning(KDECONNECT_CORE) << "UploadJob: receiver asked for invalid offset" << offset;
+        m_input->close();
+        return;
+    }
+
+    m_resumeOffset = offset;
+    if (offset == m_networkPacket.payloadSize()) {
+        // The receiver has all of it already and isn't reading anymore, there is nothing to send a checksum of either
+        m_checksumEnabled = false;
+    }
+    startSending();
+}
+
+void UploadJob::startSending()
+{
+    const qint64 startOffset = m_rangeOffset >= 0 ? m_rangeOffset : m_resumeOffset;
+    if (startOffset > 0 && !m_input->seek(startOffset)) {
+        qCWarning(KDECONNECT_CORE) << "UploadJob: could not seek to" << startOffset;
+        setError(UserDefinedError);
+        setErrorText(i18n("Could not read the file to send"));
+        m_input->close();
+        return;
+    }
+
+    if (!mapInput()) {
+        m_buffer.resize(CHUNK_SIZE);
+    }
+
+    bytesUploaded = m_resumeOffset;
+    m_bytesQueued = 0;
+    m_inputExhausted = false;
+    m_sendLimit = -1;
     setProcessedAmount(Bytes, bytesUploaded);
+    m_timer.start();
+
+    if (m_sslSocket) {
+        m_bytesWrittenConnection = connect(m_sslSocket, &QSslSocket::encryptedBytesWritten, this, &UploadJob::socketBytesWritten);
+    } else {
+        m_bytesWrittenConnection = connect(m_socket, &QIODevice::bytesWritten, this, &UploadJob::socketBytesWritten);
+    }
+
+    if (m_checksumEnabled) {
+        m_hasher = new PayloadHasher(this);
+        connect(m_hasher, &PayloadHasher::bytesHashed, this, &UploadJob::uploadNextPacket);
+    }
 
-    connect(m_socket, &QSslSocket::encryptedBytesWritten, this, &UploadJob::encryptedBytesWritten);
+    if (m_streamed) {
+        // The receiver relies on the frame length to find the start of the next payload, never send more than announced
+        m_sendLimit = m_networkPacket.payloadSize();
+        char header[LanPayloadStream::FRAME_HEADER_SIZE];
+        qToBigEndian<qint64>(m_sendLimit + (m_hasher ? PayloadHasher::HASH_SIZE : 0), header);
+        m_socket->write(header, sizeof(header));
+    } else if (m_rangeOffset >= 0) {
+        m_sendLimit = m_rangeLength;
+        char header[LanStripedPayload::STRIPE_HEADER_SIZE];
+        qToBigEndian<qint64>(m_rangeOffset, header);
+        qToBigEndian<qint64>(m_rangeLength, header + 8);
+        m_socket->write(header, sizeof(header));
+    }
 
     uploadNextPacket();
 }
 
+bool UploadJob::mapInput()
+{
+    QFileDevice *file = qobject_cast<QFileDevice *>(m_input.data());
+    if (!file || file->isSequential()) {
+        return false;
+    }
+
+    const qint64 size = file->size() - file->pos();
+    if (size <= 0) {
+        return false;
+    }
+
+    // Unmapped automatically when the file gets closed
+    m_mappedInput = file->map(file->pos(), size);
+    if (!m_mappedInput) {
+        qCDebug(KDECONNECT_CORE) << "Could not map" << file->fileName() << "falling back to buffered reads";
+        return false;
+    }
+    m_mappedSize = size;
+    return true;
+}
+
+qint64 UploadJob::bytesInFlight() const
+{
+    return m_socket->bytesToWrite() + (m_sslSocket ? m_sslSocket->encryptedBytesToWrite() : 0);
+}
+
+void UploadJob::closeSocket()
+{
+    if (m_sslSocket) {
+        m_sslSocket->disconnectFromHost();
+    } else {
+        m_socket->close();
+    }
+}
+
 void UploadJob::uploadNextPacket()
 {
-    qint64 bytesAvailable = m_input->bytesAvailable();
+    while (!m_inputExhausted && bytesInFlight() < m_highWaterMark) {
+        const qint64 maxChunk = m_sendLimit < 0 ? CHUNK_SIZE : qMin(m_sendLimit - m_bytesQueued, CHUNK_SIZE);
+        if (maxChunk <= 0) {
+            m_inputExhausted = true;
+            break;
+        }
+
+        qint64 bytesWritten;
+        if (m_mappedInput) {
+            const qint64 bytesToSend = qMin(m_mappedSize - m_bytesQueued, maxChunk);
+            if (bytesToSend <= 0) {
+                m_inputExhausted = true;
+                break;
+            }
+            const char *data = reinterpret_cast<const char *>(m_mappedInput) + m_bytesQueued;
+            bytesWritten = m_socket->write(data, bytesToSend);
+            if (m_hasher && bytesWritten > 0) {
+                // The mapping outlives the hasher, see aboutToClose()
+                m_hasher->addData(QByteArray::fromRawData(data, bytesWritten));
+            }
+        } else {
+            if (m_hasher && m_hasher->bytesPending() >= m_highWaterMark) {
+                // Every chunk is copied for the hasher, don't read faster than it keeps up. It calls us again once it caught up a bit
+                break;
+            }
+            if (m_input->bytesAvailable() <= 0) {
+                m_inputExhausted = true;
+                break;
+            }
+            const qint64 bytesRead = m_input->read(m_buffer.data(), qMin<qint64>(m_buffer.size(), maxChunk));
+            if (bytesRead <= 0) {
+                m_inputExhausted = true;
+                break;
+            }
+            bytesWritten = m_socket->write(m_buffer.constData(), bytesRead);
+            if (m_hasher && bytesWritten > 0) {
+                m_hasher->addData(QByteArray(m_buffer.constData(), bytesWritten));
+            }
+        }
+
+        if (bytesWritten < 0) {
+            qCWarning(KDECONNECT_CORE) << "UploadJob: error writing to socket" << m_socket->errorString();
+            m_inputExhausted = true;
+            break;
+        }
+        m_bytesQueued += bytesWritten;
+    }
 
-    if (bytesAvailable > 0) {
-        qint64 bytesToSend = qMin(m_input->bytesAvailable(), (qint64)4096);
-        bytesUploading = m_socket->write(m_input->read(bytesToSend));
+    // The checksum trailer follows the payload, but only if all of it could be sent
+    if (m_inputExhausted && m_hasher && !m_checksumWritten && m_bytesQueued == m_networkPacket.payloadSize() - m_resumeOffset) {
+        if (!m_hashing) {
+            m_hashing = true;
+            connect(m_hasher, &PayloadHasher::finished, this, &UploadJob::checksumReady);
+            m_hasher->finish();
+        }
+        return;
     }
 
-    if (bytesAvailable <= 0 || bytesUploading < 0) {
+    // Only close once everything has been flushed, closing the input disconnects the socket
+    if (m_inputExhausted && bytesInFlight() == 0) {
+        disconnect(m_bytesWrittenConnection);
         m_input->close();
-        disconnect(m_socket, &QSslSocket::encryptedBytesWritten, this, &UploadJob::encryptedBytesWritten);
     }
 }
 
-void UploadJob::encryptedBytesWritten(qint64 /*bytes*/)
+void UploadJob::checksumReady(const QByteArray &checksum)
 {
-    if (m_socket->encryptedBytesToWrite() == 0) {
-        bytesUploaded += bytesUploading;
-        setProcessedAmount(Bytes, bytesUploaded);
+    m_socket->write(checksum);
+    if (m_resumeOffset == 0) {
+        m_checksum = checksum;
+    }
+    m_checksumWritten = true;
+    uploadNextPacket();
+}
+
+void UploadJob::socketBytesWritten(qint64 /*bytes*/)
+{
+    // Encrypted bytes carry some TLS overhead, so this is only exact once the socket is drained
+    const qint64 bytesSent = qMax<qint64>(0, m_bytesQueued - bytesInFlight());
+    bytesUploaded = m_resumeOffset + bytesSent;
+    setProcessedAmount(Bytes, bytesUploaded);
 
-        uploadNextPacket();
+    const auto elapsed = m_timer.elapsed();
+    if (elapsed > 0) {
+        emitSpeed((1000 * bytesSent) / elapsed);
     }
+
+    uploadNextPacket();
 }
 
 void UploadJob::aboutToClose()
 {
-    m_socket->disconnectFromHost();
+    // The mapping goes away together with the file, wait for the hasher to be done with it
+    delete m_hasher;
+    m_hasher = nullptr;
+    m_mappedInput = nullptr;
+    m_inputExhausted = true;
+    disconnect(m_bytesWrittenConnection);
+
+    // A shared socket can carry the next payload, unless the receiver would now misread the frame boundaries
+    if (!m_streamed || m_bytesQueued < m_sendLimit || (m_checksumEnabled && !m_checksumWritten)) {
+        closeSocket();
+    }
     emitResult();
 }
 
+void UploadJob::socketClosed()
+{
+    if (isFinished()) {
+        return;
+    }
+
+    qCWarning(KDECONNECT_CORE) << "UploadJob: the receiver closed the connection before the payload was sent";
+    setError(UserDefinedError);
+    setErrorText(i18n("The connection to the receiving device was lost"));
+    m_input->close();
+}
+
 bool UploadJob::stop()
 {
     m_input->close();
@@ -16,30 +16,102 @@
 #include <QVariantMap>
 #include <networkpacket.h>
 
+class PayloadHasher;
+
 class KDECONNECTCORE_EXPORT UploadJob : public KJob
 {
     Q_OBJECT
 public:
     explicit UploadJob(const NetworkPacket &networkPacket);
 
-    void setSocket(QSslSocket *socket);
+    /**
+     * The connection the payload is written to, usually a payload QSslSocket.
+     * Any other device, like a multiplexed channel, is closed when the upload is done.
+     */
+    void setSocket(QIODevice *socket);
+    /**
+     * Send the payload as a single length-prefixed frame over a socket that is shared with other jobs.
+     * The socket is left open when the upload finishes and stays owned by whoever passed it in.
+     * Needs a known payload size, and has to be set before calling setSocket().
+     */
+    void setStreamed(bool streamed);
+    bool isStreamed() const;
+    /**
+     * Only send @p length bytes starting at @p offset, preceded by a stripe header.
+     * The input has to be a file, so several jobs can read different ranges of it at once.
+     */
+    void setRange(qint64 offset, qint64 length);
+    /**
+     * Wait for the receiver to ask for the payload before sending it. The request is a single
+     * JSON line, its "offset" says how much of the payload the receiver has already.
+     * The input has to be seekable.
+     */
+    void setResumable(bool resumable);
+    /**
+     * Follow the payload with its PayloadHasher checksum, covering the bytes sent on this connection
+     */
+    void setChecksumEnabled(bool enabled);
+    /**
+     * The checksum sent after the payload, once all of it was sent from its start. Empty otherwise.
+     */
+    QByteArray checksum() const;
+    /**
+     * Maximum amount of payload bytes handed to the socket but not yet written to the network.
+     * Keeping several chunks in flight means the TLS layer never runs dry between two reads.
+     */
+    void setHighWaterMark(qint64 bytes);
     void start() override;
     bool stop();
     const NetworkPacket getNetworkPacket();
 
+    constexpr static qint64 DEFAULT_HIGH_WATER_MARK = 1024 * 1024;
+    constexpr static qint64 CHUNK_SIZE = 64 * 1024;
+    constexpr static qint64 MAX_PAYLOAD_REQUEST_SIZE = 4096;
+
 private:
+    void startSending();
+    bool mapInput();
+    qint64 bytesInFlight() const;
+    void closeSocket();
+
     const NetworkPacket m_networkPacket;
     QSharedPointer<QIODevice> m_input;
-    QSslSocket *m_socket;
-    qint64 bytesUploading;
+    QIODevice *m_socket;
+    // Set when m_socket is a TLS socket, its encrypted buffer counts as in flight as well
+    QSslSocket *m_sslSocket;
+    QMetaObject::Connection m_bytesWrittenConnection;
     qint64 bytesUploaded;
+    qint64 m_bytesQueued;
+    qint64 m_highWaterMark;
+    bool m_inputExhausted;
+    bool m_streamed;
+    // Payload bytes we are allowed to send, -1 if unlimited
+    qint64 m_sendLimit;
+    qint64 m_rangeOffset;
+    qint64 m_rangeLength;
+    bool m_resumable;
+    qint64 m_resumeOffset;
+    bool m_checksumEnabled;
+    PayloadHasher *m_hasher;
+    bool m_hashing;
+    bool m_checksumWritten;
+    QByteArray m_checksum;
+
+    // Regular files are mapped and handed to the socket directly, everything else goes through m_buffer
+    const uchar *m_mappedInput;
+    qint64 m_mappedSize;
+    QByteArray m_buffer;
+    QElapsedTimer m_timer;
 
     const static quint16 MIN_PORT = 1739;
     const static quint16 MAX_PORT = 1764;
 
 private Q_SLOTS:
+    void readPayloadRequest();
+    void checksumReady(const QByteArray &checksum);
     void uploadNextPacket();
-    void encryptedBytesWritten(qint64 bytes);
+    void socketBytesWritten(qint64 bytes);
+    void socketClosed();
     void aboutToClose();
 };
 
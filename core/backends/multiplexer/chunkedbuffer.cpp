@@ -0,0 +1,109 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "chunkedbuffer.h"
+
+#include <QByteArrayView>
+#include <cstring>
+
+void ChunkedBuffer::append(const QByteArray &data)
+{
+    append(QByteArray{data});
+}
+
+void ChunkedBuffer::append(QByteArray &&data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+    m_size += data.size();
+    if (!m_chunks.isEmpty() && m_chunks.last().size() + data.size() <= MERGE_CHUNK_SIZE) {
+        m_chunks.last().append(data);
+    } else {
+        m_chunks.append(std::move(data));
+    }
+}
+
+void ChunkedBuffer::append(const char *data, qint64 size)
+{
+    if (size <= 0) {
+        return;
+    }
+    if (!m_chunks.isEmpty() && m_chunks.last().size() + size <= MERGE_CHUNK_SIZE) {
+        m_size += size;
+        m_chunks.last().append(data, size);
+    } else {
+        append(QByteArray(data, size));
+    }
+}
+
+const char *ChunkedBuffer::readPointer() const
+{
+    return m_chunks.isEmpty() ? nullptr : m_chunks.first().constData() + m_head;
+}
+
+qint64 ChunkedBuffer::nextBlockSize() const
+{
+    return m_chunks.isEmpty() ? 0 : m_chunks.first().size() - m_head;
+}
+
+void ChunkedBuffer::free(qint64 bytes)
+{
+    while (bytes > 0 && !m_chunks.isEmpty()) {
+        const qint64 amount = qMin(bytes, nextBlockSize());
+        m_head += amount;
+        m_size -= amount;
+        bytes -= amount;
+        if (m_head == m_chunks.first().size()) {
+            m_chunks.removeFirst();
+            m_head = 0;
+        }
+    }
+}
+
+qint64 ChunkedBuffer::read(char *data, qint64 maxSize)
+{
+    qint64 copied = 0;
+    while (copied < maxSize && !m_chunks.isEmpty()) {
+        const qint64 amount = qMin(maxSize - copied, nextBlockSize());
+        std::memcpy(data + copied, readPointer(), amount);
+        free(amount);
+        copied += amount;
+    }
+    return copied;
+}
+
+QByteArray ChunkedBuffer::read(qint64 maxSize)
+{
+    const qint64 amount = qMin(maxSize, m_size);
+    if (amount <= 0) {
+        return {};
+    }
+    if (m_head == 0 && m_chunks.first().size() == amount) {
+        m_size -= amount;
+        return m_chunks.takeFirst();
+    }
+    QByteArray result(amount, Qt::Uninitialized);
+    read(result.data(), amount);
+    return result;
+}
+
+bool ChunkedBuffer::contains(char c) const
+{
+    for (qsizetype i = 0; i < m_chunks.size(); ++i) {
+        if (QByteArrayView(m_chunks[i]).sliced(i == 0 ? m_head : 0).contains(c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChunkedBuffer::clear()
+{
+    m_chunks.clear();
+    m_head = 0;
+    m_size = 0;
+}
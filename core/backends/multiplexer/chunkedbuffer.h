@@ -0,0 +1,78 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef CHUNKEDBUFFER_H
+#define CHUNKEDBUFFER_H
+
+#include <QByteArray>
+#include <QList>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * A FIFO byte buffer kept as a list of chunks
+ *
+ * Consuming bytes from the front only moves an offset into the first chunk, instead of shifting the remaining
+ * bytes like QByteArray::remove(0, n) does. Appended QByteArrays are stored as they are (implicitly shared),
+ * so they are never copied into a larger buffer.
+ *
+ * @internal
+ */
+class KDECONNECTCORE_EXPORT ChunkedBuffer
+{
+public:
+    qint64 size() const
+    {
+        return m_size;
+    }
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    void append(const QByteArray &data);
+    void append(QByteArray &&data);
+    void append(const char *data, qint64 size);
+
+    /**
+     * The contiguous bytes at the front of the buffer, valid until the buffer is modified
+     */
+    const char *readPointer() const;
+    qint64 nextBlockSize() const;
+
+    /**
+     * Drop @p bytes from the front of the buffer
+     */
+    void free(qint64 bytes);
+
+    /**
+     * Move up to @p maxSize bytes from the front of the buffer into @p data
+     * @return the number of bytes moved
+     */
+    qint64 read(char *data, qint64 maxSize);
+    /**
+     * Take up to @p maxSize bytes from the front of the buffer. Doesn't copy if they make up exactly one chunk.
+     */
+    QByteArray read(qint64 maxSize);
+
+    bool contains(char c) const;
+    void clear();
+
+private:
+    /**
+     * Small appends are merged into the last chunk up to this size, so byte-wise writes don't create a chunk each
+     */
+    constexpr static qint64 MERGE_CHUNK_SIZE = 4096;
+
+    QList<QByteArray> m_chunks;
+    /**
+     * Offset of the first unread byte in the first chunk
+     */
+    qint64 m_head = 0;
+    qint64 m_size = 0;
+};
+
+#endif
@@ -0,0 +1,634 @@
+/**
+ * SPDX-FileCopyrightText: 2019 Matthijs Tijink <matthijstijink@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "connectionmultiplexer.h"
+
+#include "core_debug.h"
+#include "multiplexchannel.h"
+#include "multiplexchannelstate.h"
+#include <QIODevice>
+#include <QtEndian>
+
+/**
+ * The default channel uuid. This channel is opened implicitly (without communication).
+ */
+#define DEFAULT_CHANNEL_UUID "a0d0aaf4-1072-4d81-aa35-902a954b1266"
+
+// Message type constants
+constexpr char MESSAGE_PROTOCOL_VERSION = 0;
+constexpr char MESSAGE_OPEN_CHANNEL = 1;
+constexpr char MESSAGE_CLOSE_CHANNEL = 2;
+constexpr char MESSAGE_READ = 3;
+constexpr char MESSAGE_WRITE = 4;
+// Protocol version 2 only, with a 4 byte message length
+constexpr char MESSAGE_READ_LARGE = 5;
+constexpr char MESSAGE_WRITE_LARGE = 6;
+
+// The message length field is 2 bytes, larger reads and writes are split over several messages
+constexpr int MAX_MESSAGE_LENGTH = 0xFFFF;
+// Upper bound of a protocol version 2 write message, although a channel sends at most WRITE_QUANTUM per turn
+constexpr int MAX_LARGE_MESSAGE_LENGTH = 256 * 1024;
+
+// How many bytes a channel may send per round-robin turn
+constexpr qint64 WRITE_QUANTUM = 32 * 1024;
+// Channel data is only queued while the connection has less than this waiting to be sent, so a packet on the
+// default channel never waits behind more than about this much of an upload
+constexpr qint64 MAX_WRITE_BACKLOG = 32 * 1024;
+
+// Channels the other endpoint opened that nobody took yet, each of them may have a full read window of data waiting
+constexpr int MAX_UNREQUESTED_CHANNELS = 20;
+
+// Round trip samples above this are the sender having nothing to write rather than the connection being slow
+constexpr qint64 MAX_ROUND_TRIP_NSECS = 1000LL * 1000 * 1000;
+
+static bool isLargeMessage(char type)
+{
+    return type == MESSAGE_READ_LARGE || type == MESSAGE_WRITE_LARGE;
+}
+
+/**
+ * Create a message header: the message type (1 byte), the message length (2 bytes, or 4 bytes for the protocol version 2
+ * message types, Big-Endian) and the channel uuid (16 bytes, Big-Endian)
+ */
+static QByteArray messageHeader(char type, quint32 length, const QUuid &channelId)
+{
+    QByteArray message(1, type);
+    if (isLargeMessage(type)) {
+        message.append(4, 0);
+        qToBigEndian<quint32>(length, &message.data()[1]);
+    } else {
+        Q_ASSERT(length <= (quint32)MAX_MESSAGE_LENGTH);
+        message.append(2, 0);
+        qToBigEndian<uint16_t>(length, &message.data()[1]);
+    }
+    message.append(channelId.toRfc4122());
+    return message;
+}
+
+ConnectionMultiplexer::ConnectionMultiplexer(QIODevice *socket, QObject *parent, int channelBufferSize, uint16_t highestProtocolVersion)
+    : QObject(parent)
+    , mSocket{socket}
+    , channelBufferSize{channelBufferSize}
+    , highestProtocolVersion{highestProtocolVersion}
+    , protocolVersion{1}
+    , receivedProtocolVersion{false}
+{
+    connect(mSocket, &QIODevice::readyRead, this, &ConnectionMultiplexer::readyRead);
+    connect(mSocket, &QIODevice::aboutToClose, this, &ConnectionMultiplexer::disconnected);
+    connect(mSocket, &QIODevice::bytesWritten, this, &ConnectionMultiplexer::bytesWritten);
+
+    // Send the protocol version
+    QByteArray message(23, (char)0);
+    message[0] = MESSAGE_PROTOCOL_VERSION;
+    qToBigEndian<uint16_t>(4, &message.data()[1]);
+    // Leave UUID empty
+    // Everything before the version is known is sent in version 1, so that's always the lowest supported
+    qToBigEndian<uint16_t>(1, &message.data()[19]);
+    qToBigEndian<uint16_t>(highestProtocolVersion, &message.data()[21]);
+
+    socket->write(message);
+
+    // Send the protocol version message (queued)
+    QMetaObject::invokeMethod(this, &ConnectionMultiplexer::bytesWritten, Qt::QueuedConnection);
+
+    // Always open the default channel
+    addChannel(QUuid{QStringLiteral(DEFAULT_CHANNEL_UUID)});
+
+    // Immediately check if we can read stuff ("readyRead" may not be called in that case)
+    if (mSocket->bytesAvailable()) {
+        // But invoke it queued
+        QMetaObject::invokeMethod(this, &ConnectionMultiplexer::readyRead, Qt::QueuedConnection);
+    }
+}
+
+ConnectionMultiplexer::~ConnectionMultiplexer()
+{
+    // Always make sure we close the connection
+    close();
+}
+
+void ConnectionMultiplexer::readyRead()
+{
+    // Continue parsing messages until we need more data for another message
+    while (tryParseMessage()) { }
+}
+
+void ConnectionMultiplexer::disconnected()
+{
+    // In case we get disconnected, remove all channels
+    for (auto &&channel : channels) {
+        disconnect(channel.data(), nullptr, this, nullptr);
+        channel->disconnected();
+    }
+    channels.clear();
+    for (auto &queue : writeQueues) {
+        queue.clear();
+    }
+    for (auto channel : unrequested_channels) {
+        delete channel;
+    }
+    unrequested_channels.clear();
+}
+
+void ConnectionMultiplexer::close()
+{
+    // In case we want to close the connection, remove all channels
+    for (auto &&channel : channels) {
+        disconnect(channel.data(), nullptr, this, nullptr);
+        channel->disconnected();
+    }
+    channels.clear();
+    for (auto &queue : writeQueues) {
+        queue.clear();
+    }
+    for (auto channel : unrequested_channels) {
+        delete channel;
+    }
+    unrequested_channels.clear();
+
+    mSocket->close();
+}
+
+bool ConnectionMultiplexer::isOpen() const
+{
+    return mSocket->isOpen();
+}
+
+int ConnectionMultiplexer::negotiatedProtocolVersion() const
+{
+    return protocolVersion;
+}
+
+bool ConnectionMultiplexer::tryParseMessage()
+{
+    /**
+     * Parse the header:
+     *  - message type (1 byte)
+     *  - message length (2 bytes, or 4 bytes for the protocol version 2 message types, Big-Endian), excludes header size
+     *  - channel uuid (16 bytes, Big-Endian)
+     *
+     * The header is only peeked at, nothing is consumed until the whole message has arrived. Reading a partial message
+     * and rolling back would copy it again for every chunk of it that arrives.
+     */
+    char header[1 + 4 + 16];
+    const qint64 header_available = mSocket->peek(header, sizeof(header));
+    if (header_available < 1) {
+        return false;
+    }
+    const char message_type = header[0];
+    const int length_size = isLargeMessage(message_type) ? 4 : 2;
+    const int header_size = 1 + length_size + 16;
+    if (header_available < header_size) {
+        return false;
+    }
+
+    quint32 message_length = length_size == 4 ? qFromBigEndian<quint32>(&header[1]) : qFromBigEndian<uint16_t>(&header[1]);
+    if (message_length > (quint32)MAX_CHANNEL_BUFFER_SIZE) {
+        // No channel asks for this much, don't wait for it to arrive
+        return protocolError("message too long");
+    }
+
+    // Check if we have the full message including its data
+    if (mSocket->bytesAvailable() < header_size + (qint64)message_length) {
+        return false;
+    }
+
+    QUuid message_uuid = QUuid::fromRfc4122(QByteArrayView(header + 1 + length_size, 16));
+    mSocket->skip(header_size);
+    QByteArray data = mSocket->read(message_length);
+
+    // Everything the other endpoint sends is checked, a broken or hostile peer gets disconnected instead of being trusted
+    if (!receivedProtocolVersion && message_type != MESSAGE_PROTOCOL_VERSION) {
+        return protocolError("message before the protocol version");
+    }
+
+    // Parse the different message types
+    if (message_type == MESSAGE_OPEN_CHANNEL) {
+        // The other endpoint requested us to open a channel
+        if (message_length != 0) {
+            return protocolError("invalid open channel message");
+        }
+        if (channels.contains(message_uuid)) {
+            return protocolError("channel opened twice");
+        }
+
+        if (unrequested_channels.size() >= MAX_UNREQUESTED_CHANNELS) {
+            // Nobody is taking the channels we have already, refuse this one so the other endpoint doesn't wait for it
+            qCWarning(KDECONNECT_CORE) << "Too many unused multiplexed channels, refusing another one";
+            to_write_bytes.append(messageHeader(MESSAGE_CLOSE_CHANNEL, 0, message_uuid));
+            bytesWritten();
+            return true;
+        }
+        addChannel(message_uuid);
+    } else if (message_type == MESSAGE_READ || message_type == MESSAGE_READ_LARGE) {
+        // The other endpoint has read some data and requests more data
+        if (message_length != (uint)length_size) {
+            return protocolError("invalid read message");
+        }
+        // Read the number of bytes requested (2 bytes, or 4 bytes in MESSAGE_READ_LARGE, Big-Endian)
+        quint32 additional_read = length_size == 4 ? qFromBigEndian<quint32>(data.constData()) : qFromBigEndian<uint16_t>(data.constData());
+        if (additional_read == 0) {
+            return protocolError("empty read request");
+        }
+
+        // Check if we haven't closed the channel in the meanwhile
+        //    (note: different from the user's endpoint of a closed channel, since we might have outstanding buffers)
+        auto iter = channels.find(message_uuid);
+        if (iter != channels.end() && (*iter)->connected) {
+            auto channel = *iter;
+
+            if (channel->freeWriteAmount + (qint64)additional_read > MAX_CHANNEL_BUFFER_SIZE) {
+                // No read window is larger than that
+                return protocolError("read request too large");
+            }
+
+            // We have "additional_read" more bytes we can safely write in this channel
+            channel->freeWriteAmount += additional_read;
+            // We might still have some data in the write buffer
+            Q_EMIT channel->writeAvailable();
+            return true;
+        }
+    } else if (message_type == MESSAGE_WRITE || message_type == MESSAGE_WRITE_LARGE) {
+        // The other endpoint has written data into a channel (because we requested it)
+        if (message_length == 0) {
+            return protocolError("empty write message");
+        }
+
+        // Check if we haven't closed the channel in the meanwhile
+        //    (note: different from the user's endpoint of a closed channel, since we might have outstanding buffers)
+        auto iter = channels.find(message_uuid);
+        if (iter != channels.end() && (*iter)->connected) {
+            auto channel = *iter;
+
+            if ((quint32)channel->requestedReadAmount < message_length) {
+                return protocolError("more data written than requested");
+            }
+
+            // We received some data, so update the buffer and the amount of outstanding read requests
+            channel->requestedReadAmount -= message_length;
+            channel->read_buffer.append(std::move(data));
+
+            // Nobody reads from a channel that wasn't taken yet, it doesn't get more room than it started with
+            if (!unrequested_channels.contains(message_uuid)) {
+                updateReadWindow(channel.data(), message_length);
+            }
+            // Indicate that the channel can read some bytes
+            Q_EMIT channel->readyRead();
+            return true;
+        }
+    } else if (message_type == MESSAGE_CLOSE_CHANNEL) {
+        // The other endpoint wants to close a channel
+        if (message_length != 0) {
+            return protocolError("invalid close channel message");
+        }
+
+        // Check if we haven't closed the channel in the meanwhile
+        //    (note: different from the user's endpoint of a closed channel, since we might have outstanding buffers)
+        auto iter = channels.find(message_uuid);
+        if (iter != channels.end()) {
+            auto channel = *iter;
+
+            // We don't want signals anymore, since the channel is closed
+            disconnect(channel.data(), nullptr, this, nullptr);
+            removeChannel(message_uuid);
+        }
+    } else if (message_type == MESSAGE_PROTOCOL_VERSION) {
+        // Checks for protocol compatibility
+        if (receivedProtocolVersion || message_length < 4) {
+            return protocolError("invalid protocol version message");
+        }
+        // Read the lowest & highest version supported (each 2 bytes, Big-Endian)
+        uint16_t lowest_version = qFromBigEndian<uint16_t>(&data.data()[0]);
+        uint16_t highest_version = qFromBigEndian<uint16_t>(&data.data()[2]);
+
+        if (lowest_version != 1 || highest_version < lowest_version) {
+            return protocolError("incompatible protocol version");
+        }
+        receivedProtocolVersion = true;
+        // Both ends send version 1 messages until they know better, so there is no need to agree on a moment to switch
+        protocolVersion = qMin(highestProtocolVersion, highest_version);
+    } else {
+        // Other message types are not supported
+        return protocolError("unknown message type");
+    }
+
+    return true;
+}
+
+bool ConnectionMultiplexer::protocolError(const char *reason)
+{
+    qCWarning(KDECONNECT_CORE) << "Multiplexing protocol error:" << reason << "closing the connection";
+    close();
+    return false;
+}
+
+QUuid ConnectionMultiplexer::newChannel()
+{
+    // Create a random uuid
+    QUuid new_id = QUuid::createUuid();
+
+    // Open the channel on the other endpoint
+    to_write_bytes.append(messageHeader(MESSAGE_OPEN_CHANNEL, 0, new_id));
+
+    // Add the channel ourselves
+    addChannel(new_id);
+    // Write the data
+    bytesWritten();
+    return new_id;
+}
+
+void ConnectionMultiplexer::addChannel(QUuid new_id)
+{
+    const ChannelPriority priority = new_id == QUuid{QStringLiteral(DEFAULT_CHANNEL_UUID)} ? ControlPriority : BulkPriority;
+    MultiplexChannelState *channelState = new MultiplexChannelState(channelBufferSize, priority);
+    // Connect all channels queued, so that we have opportunities to combine read/write requests
+
+    // Note that none of the channels knows its own uuid, so we have to add it ourselves
+    connect(
+        channelState,
+        &MultiplexChannelState::readAvailable,
+        this,
+        [new_id, this]() {
+            channelCanRead(new_id);
+        },
+        Qt::QueuedConnection);
+    connect(
+        channelState,
+        &MultiplexChannelState::writeAvailable,
+        this,
+        [new_id, this]() {
+            channelCanWrite(new_id);
+        },
+        Qt::QueuedConnection);
+    connect(
+        channelState,
+        &MultiplexChannelState::requestClose,
+        this,
+        [new_id, this]() {
+            closeChannel(new_id);
+        },
+        Qt::QueuedConnection);
+
+    auto channelStatePtr = QSharedPointer<MultiplexChannelState>{channelState};
+    channels[new_id] = channelStatePtr;
+    unrequested_channels[new_id] = new MultiplexChannel{channelStatePtr};
+    // Immediately ask for data in this channel
+    Q_EMIT channelStatePtr->readAvailable();
+}
+
+std::unique_ptr<MultiplexChannel> ConnectionMultiplexer::getChannel(QUuid channelId)
+{
+    auto iter = unrequested_channels.find(channelId);
+    if (iter == unrequested_channels.end()) {
+        return nullptr;
+    } else if (!(*iter)->isOpen()) {
+        // Delete the channel
+        delete *iter;
+        unrequested_channels.erase(iter);
+        // Don't return closed channels
+        return nullptr;
+    } else {
+        auto channel = *iter;
+        unrequested_channels.erase(iter);
+        return std::unique_ptr<MultiplexChannel>{channel};
+    }
+}
+
+std::unique_ptr<MultiplexChannel> ConnectionMultiplexer::getDefaultChannel()
+{
+    return getChannel(QUuid{QStringLiteral(DEFAULT_CHANNEL_UUID)});
+}
+
+void ConnectionMultiplexer::setChannelPriority(QUuid channelId, ChannelPriority priority)
+{
+    auto iter = channels.find(channelId);
+    if (iter == channels.end())
+        return;
+    auto channel = *iter;
+
+    if (channel->writeScheduled && channel->priority != priority) {
+        writeQueues[channel->priority].removeOne(channelId);
+        writeQueues[priority].append(channelId);
+    }
+    channel->priority = priority;
+}
+
+void ConnectionMultiplexer::bytesWritten()
+{
+    writeQueued();
+    // Channel data goes out bit by bit as the connection drains, so the order is still up to the scheduler
+    // when a more important channel has something to send
+    while (to_write_bytes.size() + mSocket->bytesToWrite() < MAX_WRITE_BACKLOG && scheduleWrite()) {
+        writeQueued();
+    }
+}
+
+void ConnectionMultiplexer::writeQueued()
+{
+    // Hand the chunks to the socket one by one, they're buffered there without being joined here first
+    while (!to_write_bytes.isEmpty()) {
+        const qint64 block_size = to_write_bytes.nextBlockSize();
+        auto num_written = mSocket->write(to_write_bytes.readPointer(), block_size);
+        if (num_written <= 0) {
+            // On error: disconnected will be called later
+            // On buffer full: will be retried later
+            return;
+        }
+        to_write_bytes.free(num_written);
+        if (num_written < block_size) {
+            return;
+        }
+    }
+}
+
+bool ConnectionMultiplexer::scheduleWrite()
+{
+    // Highest priority class first
+    for (auto &queue : writeQueues) {
+        while (!queue.isEmpty()) {
+            const QUuid channelId = queue.first();
+            auto iter = channels.find(channelId);
+            if (iter == channels.end()) {
+                queue.removeFirst();
+                continue;
+            }
+            auto channel = *iter;
+
+            if (channel->write_buffer.isEmpty() || channel->freeWriteAmount <= 0) {
+                // Nothing to send until the user writes more or the other endpoint asks for more, an idle channel doesn't save up its turn
+                queue.removeFirst();
+                channel->writeScheduled = false;
+                channel->deficit = 0;
+                continue;
+            }
+
+            if (channel->deficit == 0) {
+                // The start of this channel's turn
+                channel->deficit = WRITE_QUANTUM;
+            }
+
+            const char message_type = protocolVersion >= 2 ? MESSAGE_WRITE_LARGE : MESSAGE_WRITE;
+            const int max_length = protocolVersion >= 2 ? MAX_LARGE_MESSAGE_LENGTH : MAX_MESSAGE_LENGTH;
+            QByteArray data = channel->write_buffer.read(qMin<qint64>(qMin<qint64>(channel->freeWriteAmount, max_length), channel->deficit));
+            const int amount = data.size();
+            channel->freeWriteAmount -= amount;
+            channel->deficit -= amount;
+
+            // Send the data, queued after its header without copying it into a single message
+            to_write_bytes.append(messageHeader(message_type, amount, channelId));
+            to_write_bytes.append(std::move(data));
+
+            if (channel->deficit == 0) {
+                // Turn over, on to the next channel of this class
+                queue.move(0, queue.size() - 1);
+            }
+
+            // Let the channel's users know that some data has been written
+            Q_EMIT channel->bytesWritten(amount);
+
+            // If the user previously asked to close the channel and we finally managed to write the buffer, actually close it
+            if (channel->write_buffer.isEmpty() && channel->close_after_write) {
+                closeChannel(channelId);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void ConnectionMultiplexer::channelCanRead(QUuid channelId)
+{
+    auto iter = channels.find(channelId);
+    if (iter == channels.end())
+        return;
+    auto channel = *iter;
+
+    // Check if we can request more data to read without overflowing the buffer
+    if (channel->read_buffer.size() + channel->requestedReadAmount < channel->bufferSize) {
+        // Request the exact amount to fill up the buffer
+        auto read_amount = channel->bufferSize - channel->requestedReadAmount - channel->read_buffer.size();
+        if (channel->requestedReadAmount == 0) {
+            // The other endpoint used up all it could write, the next write tells how long a round trip takes
+            channel->roundTripTimer.start();
+        }
+        channel->requestedReadAmount += read_amount;
+
+        if (protocolVersion >= 2) {
+            // Send a MESSAGE_READ_LARGE request for more data
+            QByteArray message = messageHeader(MESSAGE_READ_LARGE, 4, channelId);
+            message.append(4, 0);
+            qToBigEndian<quint32>(read_amount, &message.data()[21]);
+            to_write_bytes.append(message);
+        } else {
+            // Send MESSAGE_READ requests for more data
+            while (read_amount > 0) {
+                const uint16_t amount = qMin<qint64>(read_amount, MAX_MESSAGE_LENGTH);
+                QByteArray message = messageHeader(MESSAGE_READ, 2, channelId);
+                message.append(2, 0);
+                qToBigEndian<uint16_t>(amount, &message.data()[19]);
+                to_write_bytes.append(message);
+                read_amount -= amount;
+            }
+        }
+        // Try to send it immediately
+        bytesWritten();
+    }
+}
+
+void ConnectionMultiplexer::channelCanWrite(QUuid channelId)
+{
+    auto iter = channels.find(channelId);
+    if (iter == channels.end())
+        return;
+    auto channel = *iter;
+
+    // Check if we can freely send data and we actually have some data
+    if (channel->write_buffer.size() > 0 && channel->freeWriteAmount > 0 && !channel->writeScheduled) {
+        channel->writeScheduled = true;
+        writeQueues[channel->priority].append(channelId);
+    }
+    // Try to send it immediately
+    bytesWritten();
+}
+
+void ConnectionMultiplexer::updateReadWindow(MultiplexChannelState *channel, qint64 received)
+{
+    if (channel->roundTripTimer.isValid()) {
+        const qint64 sample = qMin(channel->roundTripTimer.nsecsElapsed(), MAX_ROUND_TRIP_NSECS);
+        channel->roundTripTimer.invalidate();
+        if (channel->roundTripNsecs < 0 || sample < channel->roundTripNsecs) {
+            channel->roundTripNsecs = sample;
+        }
+    }
+
+    // Windows only grow in protocol version 2, version 1 clients were written with small fixed windows in mind
+    if (protocolVersion < 2 || channel->roundTripNsecs < 0 || channel->bufferSize >= MAX_CHANNEL_BUFFER_SIZE) {
+        return;
+    }
+
+    if (!channel->rateTimer.isValid()) {
+        channel->rateTimer.start();
+        channel->rateBytes = 0;
+        return;
+    }
+    channel->rateBytes += received;
+
+    const qint64 elapsed = channel->rateTimer.nsecsElapsed();
+    if (elapsed < channel->roundTripNsecs || elapsed == 0) {
+        return;
+    }
+
+    // What arrives in one round trip is the bandwidth-delay product. Allowing twice that in flight means the
+    // window never is what holds the sender back, and while it still does the window doubles every round trip.
+    const qint64 bandwidthDelayProduct = channel->rateBytes * qMax<qint64>(channel->roundTripNsecs, 1) / elapsed;
+    const qint64 target = qMin<qint64>(2 * bandwidthDelayProduct, MAX_CHANNEL_BUFFER_SIZE);
+    channel->rateTimer.restart();
+    channel->rateBytes = 0;
+    if (target > channel->bufferSize) {
+        channel->bufferSize = target;
+        // Hand out the additional room right away
+        Q_EMIT channel->readAvailable();
+    }
+}
+
+void ConnectionMultiplexer::closeChannel(QUuid channelId)
+{
+    auto iter = channels.find(channelId);
+    if (iter == channels.end())
+        return;
+    auto channel = *iter;
+
+    // If the user wants to close a channel, then the user won't be reading from it anymore
+    channel->read_buffer.clear();
+    channel->close_after_write = true;
+
+    // If there's still stuff to write, don't close it just yet
+    if (!channel->write_buffer.isEmpty())
+        return;
+    channels.erase(iter);
+    channel->connected = false;
+
+    // Send the actual close channel message
+    to_write_bytes.append(messageHeader(MESSAGE_CLOSE_CHANNEL, 0, channelId));
+    // Try to send it immediately
+    bytesWritten();
+}
+
+void ConnectionMultiplexer::removeChannel(QUuid channelId)
+{
+    auto iter = channels.find(channelId);
+    if (iter == channels.end())
+        return;
+    auto channel = *iter;
+
+    // Remove the channel from the channel list
+    channels.erase(iter);
+    channel->connected = false;
+
+    Q_EMIT channel->disconnected();
+}
+
+#include "moc_connectionmultiplexer.cpp"
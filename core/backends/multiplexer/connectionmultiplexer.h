@@ -0,0 +1,210 @@
+/**
+ * SPDX-FileCopyrightText: 2019 Matthijs Tijink <matthijstijink@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef CONNECTIONMULTIPLEXER_H
+#define CONNECTIONMULTIPLEXER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QUuid>
+#include <memory>
+
+#include "chunkedbuffer.h"
+#include "kdeconnectcore_export.h"
+
+class MultiplexChannel;
+class MultiplexChannelState;
+class QIODevice;
+
+/**
+ * An utility class to split a single connection to multiple independent channels.
+ * By default (and without needing any communication with the other endpoint), a single default channel is open.
+ *
+ * Works over any sequential device, e.g. a bluetooth socket or the TLS socket of a LAN link.
+ * It only follows the device's QIODevice signals, users should call close() when the transport reports a disconnection.
+ *
+ * Destroying/closing this object will automatically close all channels.
+ */
+class KDECONNECTCORE_EXPORT ConnectionMultiplexer : public QObject
+{
+    Q_OBJECT
+public:
+    constexpr static int DEFAULT_CHANNEL_BUFFER_SIZE = 4096;
+    // Protocol version 2 windows grow up to this, depending on the measured bandwidth-delay product
+    constexpr static int MAX_CHANNEL_BUFFER_SIZE = 16 * 1024 * 1024;
+    constexpr static uint16_t PROTOCOL_VERSION = 2;
+
+    /**
+     * Channels of a higher priority class always get to write first.
+     * Channels within a class take turns (deficit round-robin), so each gets an equal share of the connection.
+     */
+    enum ChannelPriority {
+        ControlPriority, ///< The default channel, which carries the packets
+        InteractivePriority, ///< Small payloads that are shown as soon as they arrive, like notification icons
+        BulkPriority, ///< Payload transfers, the priority of every other channel unless changed
+    };
+
+    /**
+     * @param channelBufferSize How many bytes every channel may have in flight towards us at first.
+     *        Larger windows need fewer read requests per byte, which matters when the round trip is long compared to the link speed.
+     * @param highestProtocolVersion The highest protocol version to offer, only lower it for testing
+     */
+    ConnectionMultiplexer(QIODevice *socket,
+                          QObject *parent = nullptr,
+                          int channelBufferSize = DEFAULT_CHANNEL_BUFFER_SIZE,
+                          uint16_t highestProtocolVersion = PROTOCOL_VERSION);
+    ~ConnectionMultiplexer();
+
+    /**
+     * Open a new channel within this connection.
+     *
+     * @return The uuid to refer to this channel.
+     * @see getChannel()
+     */
+    QUuid newChannel();
+    /**
+     * Get the channel device for the specified channel uuid.
+     * If the channel does not exist, this will return a null pointer.
+     *
+     * A channel is guaranteed to exist until the first call to get it.
+     * @param channelId The channel uuid
+     * @return A shared pointer to the channel object
+     * @see getDefaultChannel()
+     */
+    std::unique_ptr<MultiplexChannel> getChannel(QUuid channelId);
+    /**
+     * Get the default channel.
+     *
+     * @see getChannel()
+     */
+    std::unique_ptr<MultiplexChannel> getDefaultChannel();
+
+    /**
+     * Change the priority class of a channel, it applies to data not sent yet.
+     */
+    void setChannelPriority(QUuid channelId, ChannelPriority priority);
+
+    /**
+     * Close all channels and the underlying connection.
+     */
+    void close();
+
+    /**
+     * Check if the underlying connection is still open.
+     * @return True if the connection is open
+     * @see close()
+     */
+    bool isOpen() const;
+
+    /**
+     * The protocol version both endpoints support, 1 until the other endpoint's version message arrived.
+     */
+    int negotiatedProtocolVersion() const;
+
+private:
+    /**
+     * The underlying connection
+     */
+    QIODevice *mSocket;
+    /**
+     * The read window of every channel
+     */
+    int channelBufferSize;
+    /**
+     * The highest protocol version we offer, and the one in use
+     */
+    uint16_t highestProtocolVersion;
+    uint16_t protocolVersion;
+    /**
+     * The buffer of to-be-written bytes, message headers and channel data are kept as separate chunks
+     */
+    ChunkedBuffer to_write_bytes;
+    /**
+     * The channels not requested by the user yet
+     */
+    QHash<QUuid, MultiplexChannel *> unrequested_channels;
+    /**
+     * All channels currently open
+     */
+    QHash<QUuid, QSharedPointer<MultiplexChannelState>> channels;
+    /**
+     * The channels with data they may send, one round-robin queue per priority class
+     */
+    QList<QUuid> writeQueues[BulkPriority + 1];
+    /**
+     * True once the other side has sent its protocol version
+     */
+    bool receivedProtocolVersion;
+
+    /**
+     * Slot for connection reading
+     */
+    void readyRead();
+    /**
+     * Slot for disconnection
+     */
+    void disconnected();
+    /**
+     * Slot for progress in writing data/new data available to be written
+     */
+    void bytesWritten();
+    /**
+     * Hand as much of to_write_bytes to the connection as it takes
+     */
+    void writeQueued();
+    /**
+     * Queue a single write message for the channel whose turn it is
+     *
+     * @return False if no channel has anything to send
+     */
+    bool scheduleWrite();
+    /**
+     * Tries to parse a single connection message.
+     *
+     * @return True if a message was parsed successfully.
+     */
+    bool tryParseMessage();
+    /**
+     * The other endpoint broke the protocol, closes the connection
+     *
+     * @return False, for tryParseMessage() to return
+     */
+    bool protocolError(const char *reason);
+    /**
+     * Add a new channel. Assumes that the communication about this channel is done
+     * (i.e. the other endpoint also knows this channel exists).
+     *
+     * @param new_id The channel uuid
+     */
+    void addChannel(QUuid new_id);
+
+    /**
+     * Measure the round trip time and bandwidth of a channel after receiving data, and grow its read window to match
+     */
+    void updateReadWindow(MultiplexChannelState *channel, qint64 received);
+
+    /**
+     * Slot for closing a channel
+     */
+    void closeChannel(QUuid channelId);
+    /**
+     * Slot for a channel having new data or being allowed to send more, schedules it for writing
+     */
+    void channelCanWrite(QUuid channelId);
+    /**
+     * Slot for indicating that a channel can receive more data
+     */
+    void channelCanRead(QUuid channelId);
+    /**
+     * Slot for removing a channel from tracking
+     */
+    void removeChannel(QUuid channelId);
+};
+
+#endif
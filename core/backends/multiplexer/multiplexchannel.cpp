@@ -21,6 +21,8 @@ MultiplexChannel::MultiplexChannel(QSharedPointer<MultiplexChannelState> state)
 
 MultiplexChannel::~MultiplexChannel()
 {
+    // Let the other endpoint know nobody is going to read this channel anymore, instead of leaving it waiting for read requests
+    close();
 }
 
 bool MultiplexChannel::atEnd() const
@@ -32,6 +34,7 @@ void MultiplexChannel::disconnect()
 {
     state->connected = false;
     setOpenMode(QIODevice::ReadOnly);
+    Q_EMIT readChannelFinished();
     Q_EMIT state->readyRead();
     Q_EMIT state->requestClose();
     if (state->read_buffer.isEmpty()) {
@@ -51,29 +54,15 @@ qint64 MultiplexChannel::bytesToWrite() const
 
 qint64 MultiplexChannel::readData(char *data, qint64 maxlen)
 {
-    if (maxlen <= state->read_buffer.size()) {
-        for (int i = 0; i < maxlen; ++i) {
-            data[i] = state->read_buffer[i];
-        }
-        state->read_buffer.remove(0, maxlen);
-        Q_EMIT state->readAvailable();
-        if (!state->connected && state->read_buffer.isEmpty()) {
-            close();
-        }
-        return maxlen;
-    } else if (state->read_buffer.size() > 0) {
-        auto num_to_read = state->read_buffer.size();
-        for (int i = 0; i < num_to_read; ++i) {
-            data[i] = state->read_buffer[i];
-        }
-        state->read_buffer.remove(0, num_to_read);
+    if (state->read_buffer.size() > 0) {
+        const qint64 num_read = state->read_buffer.read(data, maxlen);
         Q_EMIT state->readAvailable();
         if (!state->connected && state->read_buffer.isEmpty()) {
             close();
         }
-        return num_to_read;
+        return num_read;
     } else if (isOpen() && state->connected) {
-        if (state->requestedReadAmount < BUFFER_SIZE) {
+        if (state->requestedReadAmount < state->bufferSize) {
             Q_EMIT state->readAvailable();
         }
         return 0;
@@ -10,6 +10,8 @@
 #include <QIODevice>
 #include <QSharedPointer>
 
+#include "kdeconnectcore_export.h"
+
 class ConnectionMultiplexer;
 class MultiplexChannelState;
 
@@ -19,7 +21,7 @@ class MultiplexChannelState;
  * @see ConnectionMultiplexer
  * @see ConnectionMultiplexer::getChannel
  */
-class MultiplexChannel : public QIODevice
+class KDECONNECTCORE_EXPORT MultiplexChannel : public QIODevice
 {
     Q_OBJECT
 
@@ -32,8 +34,6 @@ private:
 public:
     ~MultiplexChannel();
 
-    constexpr static int BUFFER_SIZE = 4096;
-
     bool canReadLine() const override;
     bool atEnd() const override;
     qint64 bytesAvailable() const override;
@@ -6,9 +6,15 @@
 
 #include "multiplexchannelstate.h"
 
-MultiplexChannelState::MultiplexChannelState()
-    : requestedReadAmount{0}
+MultiplexChannelState::MultiplexChannelState(int bufferSize, int priority)
+    : bufferSize{bufferSize}
+    , requestedReadAmount{0}
     , freeWriteAmount{0}
+    , roundTripNsecs{-1}
+    , rateBytes{0}
+    , priority{priority}
+    , deficit{0}
+    , writeScheduled{false}
     , connected{true}
     , close_after_write{false}
 {
@@ -7,7 +7,8 @@
 #ifndef MULTIPLEXCHANNELSTATE_H
 #define MULTIPLEXCHANNELSTATE_H
 
-#include <QByteArray>
+#include "chunkedbuffer.h"
+#include <QElapsedTimer>
 #include <QObject>
 
 class ConnectionMultiplexer;
@@ -24,20 +25,20 @@ class MultiplexChannelState : public QObject
     Q_OBJECT
 
 private:
-    MultiplexChannelState();
+    MultiplexChannelState(int bufferSize, int priority);
 
-public:
-    constexpr static int BUFFER_SIZE = 4096;
-
-private:
     /**
      * The read buffer (already read from underlying connection but not read by the user of the channel)
      */
-    QByteArray read_buffer;
+    ChunkedBuffer read_buffer;
     /**
      * The write buffer (already written by the user of the channel, but not to the underlying connection yet)
      */
-    QByteArray write_buffer;
+    ChunkedBuffer write_buffer;
+    /**
+     * The maximum amount of bytes in the read buffer plus the outstanding read requests
+     */
+    int bufferSize;
     /**
      * The amount of bytes requested to the other endpoint
      */
@@ -46,6 +47,31 @@ private:
      * The amount of bytes the other endpoint requested
      */
     int freeWriteAmount;
+    /**
+     * Started when all outstanding read requests were used up and a new one is sent, to measure the round trip time
+     */
+    QElapsedTimer roundTripTimer;
+    /**
+     * The shortest round trip time measured, -1 if unknown
+     */
+    qint64 roundTripNsecs;
+    /**
+     * Bytes received since rateTimer was started, to measure the bandwidth
+     */
+    QElapsedTimer rateTimer;
+    qint64 rateBytes;
+    /**
+     * The ConnectionMultiplexer::ChannelPriority of this channel
+     */
+    int priority;
+    /**
+     * The bytes this channel may still send in its current round-robin turn
+     */
+    qint64 deficit;
+    /**
+     * True if the channel is in its priority class' write queue
+     */
+    bool writeScheduled;
     /**
      * True if the channel is still connected in the underlying connection
      */
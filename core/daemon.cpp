@@ -34,7 +34,7 @@ struct DaemonPrivate {
     // Different ways to find devices and connect to them
     QSet<LinkProvider *> m_linkProviders;
 
-    // Every known device
+    // Every known device, by id. Ordered, so that the D-Bus calls list them the same way on every run
     QMap<QString, Device *> m_devices;
 
     bool m_testMode;
@@ -115,12 +115,7 @@ void Daemon::forceOnNetworkChange()
 
 Device *Daemon::getDevice(const QString &deviceId)
 {
-    for (Device *device : qAsConst(d->m_devices)) {
-        if (device->id() == deviceId) {
-            return device;
-        }
-    }
-    return nullptr;
+    return d->m_devices.value(deviceId);
 }
 
 QSet<LinkProvider *> Daemon::getLinkProviders() const
@@ -160,9 +155,8 @@ void Daemon::onNewDeviceLink(DeviceLink *link)
 
     qCDebug(KDECONNECT_CORE) << "Device discovered" << id << "via link with priority" << link->priority();
 
-    if (d->m_devices.contains(id)) {
+    if (Device *device = d->m_devices.value(id)) {
         qCDebug(KDECONNECT_CORE) << "It is a known device" << link->deviceInfo().name;
-        Device *device = d->m_devices[id];
         bool wasReachable = device->isReachable();
         device->addLink(link);
         if (!wasReachable) {
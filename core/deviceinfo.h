@@ -101,6 +101,7 @@ struct DeviceInfo {
     int protocolVersion;
     QSet<QString> incomingCapabilities;
     QSet<QString> outgoingCapabilities;
+    QSet<QString> linkCapabilities; // see linkcapabilities.h
 
     DeviceInfo(const QString &id,
                const QSslCertificate &certificate,
@@ -108,7 +109,8 @@ struct DeviceInfo {
                DeviceType type,
                int protocolVersion = 0,
                const QSet<QString> &incomingCapabilities = QSet<QString>(),
-               const QSet<QString> &outgoingCapabilities = QSet<QString>())
+               const QSet<QString> &outgoingCapabilities = QSet<QString>(),
+               const QSet<QString> &linkCapabilities = QSet<QString>())
         : id(id)
         , certificate(certificate)
         , name(name)
@@ -116,6 +118,7 @@ struct DeviceInfo {
         , protocolVersion(protocolVersion)
         , incomingCapabilities(incomingCapabilities)
         , outgoingCapabilities(outgoingCapabilities)
+        , linkCapabilities(linkCapabilities)
     {
     }
 
@@ -128,6 +131,9 @@ struct DeviceInfo {
         np.set(QStringLiteral("protocolVersion"), protocolVersion);
         np.set(QStringLiteral("incomingCapabilities"), incomingCapabilities.values());
         np.set(QStringLiteral("outgoingCapabilities"), outgoingCapabilities.values());
+        if (!linkCapabilities.isEmpty()) {
+            np.set(QStringLiteral("linkCapabilities"), linkCapabilities.values());
+        }
         return np;
     }
 
@@ -135,6 +141,7 @@ struct DeviceInfo {
     {
         QStringList incomingCapabilities = np.get<QStringList>(QStringLiteral("incomingCapabilities"));
         QStringList outgoingCapabilities = np.get<QStringList>(QStringLiteral("outgoingCapabilities"));
+        QStringList linkCapabilities = np.get<QStringList>(QStringLiteral("linkCapabilities"));
 
         return DeviceInfo(np.get<QString>(QStringLiteral("deviceId")),
                           certificate,
@@ -142,7 +149,8 @@ struct DeviceInfo {
                           DeviceType::FromString(np.get<QString>(QStringLiteral("deviceType"))),
                           np.get<int>(QStringLiteral("protocolVersion"), -1),
                           QSet<QString>(incomingCapabilities.begin(), incomingCapabilities.end()),
-                          QSet<QString>(outgoingCapabilities.begin(), outgoingCapabilities.end()));
+                          QSet<QString>(outgoingCapabilities.begin(), outgoingCapabilities.end()),
+                          QSet<QString>(linkCapabilities.begin(), linkCapabilities.end()));
     }
 };
 
@@ -7,26 +7,125 @@
 
 #include "filetransferjob.h"
 #include "daemon.h"
+#include "partialtransferjournal.h"
+#include "payloadhasher.h"
+#include "rangedpayload.h"
 #include <core_debug.h>
 
 #include <QDebug>
 #include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <qalgorithms.h>
 
 #include <KFileUtils>
+#include <KIO/DeleteJob>
+#include <KIO/FileCopyJob>
+#include <KIO/Global>
 #include <KLocalizedString>
 
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#endif
+
+/**
+ * Passes the first @p size bytes of a payload on to an upload, hashing them on the way, and then takes the checksum
+ * trailer the sender put after them
+ */
+class ChecksumTrailerDevice : public QIODevice
+{
+public:
+    ChecksumTrailerDevice(QIODevice *origin, qint64 size, PayloadHasher *hasher, QObject *parent)
+        : QIODevice(parent)
+        , m_origin(origin)
+        , m_size(size)
+        , m_passed(0)
+        , m_hasher(hasher)
+    {
+        connect(origin, &QIODevice::readyRead, this, [this]() {
+            if (m_passed < m_size) {
+                Q_EMIT readyRead();
+            }
+        });
+        connect(origin, &QIODevice::readChannelFinished, this, &QIODevice::readChannelFinished);
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return qMin(m_origin->bytesAvailable(), m_size - m_passed);
+    }
+
+    /**
+     * Reads the trailer once the whole payload was passed on. Returns true once it's complete.
+     */
+    bool takeTrailer()
+    {
+        if (m_passed == m_size && m_trailer.size() < PayloadHasher::HASH_SIZE) {
+            m_trailer += m_origin->read(PayloadHasher::HASH_SIZE - m_trailer.size());
+        }
+        return m_trailer.size() == PayloadHasher::HASH_SIZE;
+    }
+
+    QByteArray trailer() const
+    {
+        return m_trailer;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const qint64 bytesRead = m_origin->read(data, qMin(maxSize, m_size - m_passed));
+        if (bytesRead > 0) {
+            m_hasher->addData(QByteArray(data, bytesRead));
+            m_passed += bytesRead;
+        }
+        return bytesRead;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize) override
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    QIODevice *const m_origin;
+    const qint64 m_size;
+    qint64 m_passed;
+    PayloadHasher *const m_hasher;
+    QByteArray m_trailer;
+};
+
 FileTransferJob::FileTransferJob(const NetworkPacket *np, const QUrl &destination)
     : KJob()
     , m_origin(np->payload())
+    , m_rangedOrigin(nullptr)
     , m_reply(nullptr)
+    , m_file(nullptr)
+    , m_originFinished(false)
     , m_from(QStringLiteral("KDE Connect"))
     , m_destination(destination)
     , m_written(0)
     , m_size(np->payloadSize())
     , m_np(np)
     , m_autoRename(false)
+    , m_resumeOffset(0)
+    , m_journaled(0)
+    , m_hasher(nullptr)
+    , m_checksumDevice(nullptr)
+    , m_checksumReceived(false)
 {
     Q_ASSERT(m_origin);
     // Disabled this assert: QBluetoothSocket doesn't report "->isReadable() == true" until it's connected
@@ -55,18 +154,348 @@ void FileTransferJob::doStart()
             QString fileName = fileInfo.fileName();
             m_destination.setPath(path + QStringLiteral("/") + KFileUtils::suggestName(QUrl(path), fileName), QUrl::DecodedMode);
         } else {
-            setError(2);
+            setError(DestinationExistsError);
             setErrorText(i18n("Filename already present"));
             emitResult();
             return;
         }
     }
 
+    if (m_destination.isLocalFile()) {
+        // Payloads can only be skipped if we get to ask for them
+        if (!m_copySource.isEmpty() && isResumable()) {
+            startCopy();
+        } else {
+            startLocalTransfer();
+        }
+        return;
+    }
+
+    if (isResumable()) {
+        requestPayload(0);
+    }
+
     if (m_origin->bytesAvailable())
         startTransfer();
     connect(m_origin.data(), &QIODevice::readyRead, this, &FileTransferJob::startTransfer);
 }
 
+bool FileTransferJob::isResumable() const
+{
+    return m_size > 0 && m_np->payloadTransferInfo().value(QStringLiteral("resumable")).toBool();
+}
+
+void FileTransferJob::requestPayload(qint64 offset)
+{
+    // The sender waits for this before sending anything
+    const QJsonObject request{{QStringLiteral("offset"), offset}};
+    m_origin->write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+}
+
+QString FileTransferJob::partFilePath() const
+{
+    const QFileInfo fileInfo(m_destination.toLocalFile() + QStringLiteral(".part"));
+    if (!fileInfo.exists()) {
+        return fileInfo.filePath();
+    }
+    return fileInfo.path() + QStringLiteral("/") + KFileUtils::suggestName(QUrl::fromLocalFile(fileInfo.path()), fileInfo.fileName());
+}
+
+void FileTransferJob::startCopy()
+{
+    qCDebug(KDECONNECT_CORE) << "Already have the contents of" << m_destination << "in" << m_copySource;
+
+    // Asking for the payload from its end means the sender has nothing left to send
+    requestPayload(m_size);
+
+    setTotalAmount(Bytes, m_size);
+    if (cloneCopySource()) {
+        m_origin->close();
+        m_written = m_size;
+        setProcessedAmount(Bytes, m_written);
+        transferFinished();
+        return;
+    }
+
+    KIO::FileCopyJob *copyJob = KIO::file_copy(QUrl::fromLocalFile(m_copySource), m_destination, -1, KIO::HideProgressInfo);
+    connect(copyJob, &KJob::result, this, [this](KJob *job) {
+        m_origin->close();
+        if (job->error()) {
+            qCWarning(KDECONNECT_CORE) << "Could not copy" << m_copySource << "to" << m_destination << job->errorString();
+            setError(job->error());
+            setErrorText(i18n("Could not write to %1: %2", m_destination.fileName(), job->errorString()));
+            emitResult();
+            return;
+        }
+        m_written = m_size;
+        setProcessedAmount(Bytes, m_written);
+        transferFinished();
+    });
+}
+
+bool FileTransferJob::cloneCopySource()
+{
+#ifdef Q_OS_LINUX
+    // A reflink shares the blocks of the file we have until either copy is written to, so it takes neither time nor space. Unlike a
+    // hardlink, editing one of the files never changes the other.
+    QFile source(m_copySource);
+    QFile destination(m_destination.toLocalFile());
+    if (!source.open(QIODevice::ReadOnly) || !destination.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        return false;
+    }
+    if (ioctl(destination.handle(), FICLONE, source.handle()) == 0) {
+        return true;
+    }
+    // Not a filesystem that shares blocks, or not the same filesystem
+    qCDebug(KDECONNECT_CORE) << "Could not clone" << m_copySource << "copying it instead" << strerror(errno);
+    destination.remove();
+#endif
+    return false;
+}
+
+void FileTransferJob::startLocalTransfer()
+{
+    QString path = m_destination.toLocalFile();
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Unbuffered;
+    if (isResumable()) {
+        m_resumeKey = PartialTransferJournal::key(m_sourceDeviceId,
+                                                  m_np->get<QString>(QStringLiteral("filename")),
+                                                  m_size,
+                                                  m_np->get<qint64>(QStringLiteral("lastModified")));
+        const PartialTransferJournal::Entry entry = PartialTransferJournal::lookup(m_resumeKey);
+        if (!entry.partPath.isEmpty() && entry.committed < m_size) {
+            path = entry.partPath;
+            m_resumeOffset = entry.committed;
+            qCDebug(KDECONNECT_CORE) << "Resuming" << path << "from" << m_resumeOffset;
+        } else {
+            path = partFilePath();
+        }
+    }
+    if (m_resumeOffset == 0) {
+        mode |= QIODevice::Truncate;
+    }
+
+    m_file = new QFile(path, this);
+    // Unbuffered: we already write in large chunks, QFile's own buffer would only add a copy
+    if (!m_file->open(mode)) {
+        qCWarning(KDECONNECT_CORE) << "Could not open" << m_file->fileName() << "for writing:" << m_file->errorString();
+        setError(KIO::ERR_CANNOT_OPEN_FOR_WRITING);
+        setErrorText(i18n("Could not write to %1: %2", m_file->fileName(), m_file->errorString()));
+        emitResult();
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_size > 0) {
+        // Reserve the whole file up front, so we fail early if it doesn't fit and the file doesn't get fragmented. Unlike posix_fallocate this
+        // never falls back to writing zeros, which would block the event loop for seconds on large files; without support it just fails
+        if (fallocate(m_file->handle(), FALLOC_FL_KEEP_SIZE, 0, m_size) == -1 && errno == ENOSPC) {
+            m_file->close();
+            deleteDestinationFile();
+            setError(KIO::ERR_DISK_FULL);
+            setErrorText(i18n("Not enough space to receive %1", m_destination.fileName()));
+            emitResult();
+            return;
+        }
+    }
+#endif
+
+    if (m_resumeOffset > 0 && !m_file->seek(m_resumeOffset)) {
+        qCWarning(KDECONNECT_CORE) << "Could not continue" << m_file->fileName() << "starting over";
+        m_resumeOffset = 0;
+        m_file->resize(0);
+    }
+    m_written = m_resumeOffset;
+    m_journaled = m_resumeOffset;
+    if (!m_resumeKey.isEmpty()) {
+        requestPayload(m_resumeOffset);
+    }
+
+    m_rangedOrigin = dynamic_cast<RangedPayload *>(m_origin.data());
+    if (!m_rangedOrigin && m_np->payloadTransferInfo().value(QStringLiteral("checksum")).toString() == PayloadHasher::algorithmName()) {
+        m_hasher = new PayloadHasher(this);
+    }
+#ifdef Q_OS_LINUX
+    if (!m_rangedOrigin) {
+        posix_fadvise(m_file->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+
+    setProcessedAmount(Bytes, m_written);
+    if (m_size >= 0) {
+        setTotalAmount(Bytes, m_size);
+    }
+    m_buffer.resize(CHUNK_SIZE);
+
+    connect(m_origin.data(), &QIODevice::readyRead, this, &FileTransferJob::readFromOrigin);
+    connect(m_origin.data(), &QIODevice::readChannelFinished, this, &FileTransferJob::originFinished);
+    connect(m_origin.data(), &QIODevice::aboutToClose, this, &FileTransferJob::originFinished);
+
+    readFromOrigin();
+}
+
+void FileTransferJob::readFromOrigin()
+{
+    if (!m_file || !m_file->isOpen()) {
+        return;
+    }
+
+    int chunks = 0;
+    while (originBytesAvailable() > 0 && (m_originFinished || chunks < MAX_CHUNKS_PER_ITERATION)) {
+        qint64 maxRead = m_buffer.size();
+        if (m_size >= 0) {
+            maxRead = qMin(maxRead, m_size - m_written);
+        }
+        if (maxRead <= 0) {
+            break;
+        }
+
+        qint64 offset = m_written;
+        const qint64 bytesRead = m_rangedOrigin ? m_rangedOrigin->readAnyRange(m_buffer.data(), maxRead, &offset) : m_origin->read(m_buffer.data(), maxRead);
+        if (bytesRead <= 0) {
+            break;
+        }
+        if ((m_rangedOrigin && !m_file->seek(offset)) || m_file->write(m_buffer.constData(), bytesRead) != bytesRead) {
+            const QString errorString = m_file->errorString();
+            qCWarning(KDECONNECT_CORE) << "Error writing" << m_file->fileName() << errorString;
+            m_origin->disconnect(this);
+            m_file->close();
+            deleteDestinationFile();
+            setError(KIO::ERR_CANNOT_WRITE);
+            setErrorText(i18n("Could not write to %1: %2", m_file->fileName(), errorString));
+            emitResult();
+            return;
+        }
+        if (m_hasher) {
+            m_hasher->addData(QByteArray(m_buffer.constData(), bytesRead));
+        }
+        m_written += bytesRead;
+        chunks++;
+    }
+
+    if (chunks > 0) {
+        if (!m_timer.isValid())
+            m_timer.start();
+        setProcessedAmount(Bytes, m_written);
+
+        const auto elapsed = m_timer.elapsed();
+        if (elapsed > 0) {
+            emitSpeed((1000 * (m_written - m_resumeOffset)) / elapsed);
+        }
+
+        if (!m_resumeKey.isEmpty() && m_written - m_journaled >= JOURNAL_INTERVAL) {
+            PartialTransferJournal::store(m_resumeKey, {m_file->fileName(), m_written});
+            m_journaled = m_written;
+        }
+    }
+
+    if (m_size >= 0 && m_written >= m_size) {
+        if (m_hasher && !m_checksumReceived) {
+            const bool originDone = m_originFinished || !m_origin->isOpen();
+            if (m_origin->bytesAvailable() < PayloadHasher::HASH_SIZE && !originDone) {
+                // The checksum trailer is still on its way
+                return;
+            }
+            m_expectedChecksum = m_origin->read(PayloadHasher::HASH_SIZE);
+            m_checksumReceived = true;
+        }
+        finishLocalTransfer();
+    } else if (originBytesAvailable() > 0) {
+        QMetaObject::invokeMethod(this, &FileTransferJob::readFromOrigin, Qt::QueuedConnection);
+    } else if (m_originFinished || !m_origin->isOpen() || (!m_origin->isSequential() && m_origin->atEnd())) {
+        finishLocalTransfer();
+    }
+}
+
+qint64 FileTransferJob::originBytesAvailable() const
+{
+    return m_rangedOrigin ? m_rangedOrigin->rangeBytesAvailable() : m_origin->bytesAvailable();
+}
+
+void FileTransferJob::originFinished()
+{
+    // Called before the origin gets closed, so drain whatever it still has buffered
+    m_originFinished = true;
+    readFromOrigin();
+}
+
+void FileTransferJob::finishLocalTransfer()
+{
+    m_origin->disconnect(this);
+    m_file->close();
+
+    if (m_hasher && m_written == m_size) {
+        // The last chunks might still be hashed on the worker thread
+        connect(m_hasher, &PayloadHasher::finished, this, &FileTransferJob::verifyChecksum);
+        m_hasher->finish();
+        return;
+    }
+
+    completeLocalTransfer();
+}
+
+void FileTransferJob::verifyChecksum(const QByteArray &checksum)
+{
+    if (checksum != m_expectedChecksum) {
+        qCWarning(KDECONNECT_CORE) << "Checksum mismatch for" << m_destination << "deleting";
+        if (m_file) {
+            deleteDestinationFile();
+        } else {
+            KIO::del(m_destination, KIO::HideProgressInfo);
+        }
+        setError(ChecksumMismatchError);
+        setErrorText(i18n("Received corrupted file from: %1", m_from));
+        emitResult();
+        return;
+    }
+
+    if (m_resumeOffset == 0) {
+        m_verifiedChecksum = checksum;
+    }
+    completeLocalTransfer();
+}
+
+void FileTransferJob::completeLocalTransfer()
+{
+    if (!m_resumeKey.isEmpty()) {
+        if (m_written == m_size) {
+            if (!commitPartFile()) {
+                return;
+            }
+        } else if (m_written > 0) {
+            qCDebug(KDECONNECT_CORE) << "Keeping" << m_file->fileName() << "to continue the transfer later";
+            PartialTransferJournal::store(m_resumeKey, {m_file->fileName(), m_written});
+        } else {
+            m_file->remove();
+        }
+    }
+
+    transferFinished();
+}
+
+bool FileTransferJob::commitPartFile()
+{
+    PartialTransferJournal::remove(m_resumeKey);
+    m_resumeKey.clear();
+
+    // Something else might have taken the name while we were receiving
+    if (QFile::exists(m_destination.toLocalFile())) {
+        const QFileInfo fileInfo(m_destination.toLocalFile());
+        const QString path = fileInfo.path();
+        m_destination.setPath(path + QStringLiteral("/") + KFileUtils::suggestName(QUrl::fromLocalFile(path), fileInfo.fileName()), QUrl::DecodedMode);
+    }
+
+    if (!m_file->rename(m_destination.toLocalFile())) {
+        qCWarning(KDECONNECT_CORE) << "Could not rename" << m_file->fileName() << "to" << m_destination << m_file->errorString();
+        setError(KIO::ERR_CANNOT_RENAME_PARTIAL);
+        setErrorText(i18n("Could not write to %1: %2", m_destination.fileName(), m_file->errorString()));
+        m_file->remove();
+        emitResult();
+        return false;
+    }
+    return true;
+}
+
 void FileTransferJob::startTransfer()
 {
     // Don't put each ready read
@@ -80,7 +509,26 @@ void FileTransferJob::startTransfer()
         setTotalAmount(Bytes, m_size);
         req.setHeader(QNetworkRequest::ContentLengthHeader, m_size);
     }
-    m_reply = Daemon::instance()->networkAccessManager()->put(req, m_origin.data());
+
+    QIODevice *uploadOrigin = m_origin.data();
+    if (m_size >= 0 && m_np->payloadTransferInfo().value(QStringLiteral("checksum")).toString() == PayloadHasher::algorithmName()) {
+        // The upload only takes m_size bytes, the checksum after them is verified before the job finishes
+        m_hasher = new PayloadHasher(this);
+        m_checksumDevice = new ChecksumTrailerDevice(m_origin.data(), m_size, m_hasher, this);
+        uploadOrigin = m_checksumDevice;
+        connect(m_origin.data(), &QIODevice::readyRead, this, [this]() {
+            if (m_reply->isFinished()) {
+                uploadFinished();
+            }
+        });
+        connect(m_origin.data(), &QIODevice::readChannelFinished, this, [this]() {
+            m_originFinished = true;
+            if (m_reply->isFinished()) {
+                uploadFinished();
+            }
+        });
+    }
+    m_reply = Daemon::instance()->networkAccessManager()->put(req, uploadOrigin);
 
     connect(m_reply, &QNetworkReply::uploadProgress, this, [this](qint64 bytesSent, qint64 /*bytesTotal*/) {
         if (!m_timer.isValid())
@@ -95,7 +543,39 @@ void FileTransferJob::startTransfer()
         m_written = bytesSent;
     });
     connect(m_reply, &QNetworkReply::errorOccurred, this, &FileTransferJob::transferFailed);
-    connect(m_reply, &QNetworkReply::finished, this, &FileTransferJob::transferFinished);
+    connect(m_reply, &QNetworkReply::finished, this, &FileTransferJob::uploadFinished);
+}
+
+void FileTransferJob::uploadFinished()
+{
+    if (!m_checksumDevice || m_reply->error() != QNetworkReply::NoError || m_written != m_size) {
+        transferFinished();
+        return;
+    }
+    if (m_checksumReceived) {
+        // Already being verified
+        return;
+    }
+
+    if (!m_checksumDevice->takeTrailer()) {
+        if (!m_originFinished && m_origin->isOpen()) {
+            // The checksum is still on its way, we get here again when more arrives
+            return;
+        }
+        qCWarning(KDECONNECT_CORE) << "Payload for" << m_destination << "ended without its checksum";
+        m_origin->disconnect(this);
+        KIO::del(m_destination, KIO::HideProgressInfo);
+        setError(IncompleteTransferError);
+        setErrorText(i18n("Received incomplete file from: %1", m_from));
+        emitResult();
+        return;
+    }
+
+    m_origin->disconnect(this);
+    m_checksumReceived = true;
+    m_expectedChecksum = m_checksumDevice->trailer();
+    connect(m_hasher, &PayloadHasher::finished, this, &FileTransferJob::verifyChecksum);
+    m_hasher->finish();
 }
 
 void FileTransferJob::transferFailed(QNetworkReply::NetworkError error)
@@ -110,16 +590,16 @@ void FileTransferJob::transferFailed(QNetworkReply::NetworkError error)
 
 void FileTransferJob::transferFinished()
 {
-    // TODO: MD5-check the file
     if (m_size == m_written) {
         qCDebug(KDECONNECT_CORE) << "Finished transfer" << m_destination;
         emitResult();
     } else {
-        qCDebug(KDECONNECT_CORE) << "Received incomplete file (" << m_written << "/" << m_size << "bytes ), deleting";
-
-        deleteDestinationFile();
+        if (m_resumeKey.isEmpty()) {
+            qCDebug(KDECONNECT_CORE) << "Received incomplete file (" << m_written << "/" << m_size << "bytes ), deleting";
+            deleteDestinationFile();
+        }
 
-        setError(3);
+        setError(IncompleteTransferError);
         setErrorText(i18n("Received incomplete file from: %1", m_from));
         emitResult();
     }
@@ -127,6 +607,12 @@ void FileTransferJob::transferFinished()
 
 void FileTransferJob::deleteDestinationFile()
 {
+    if (!m_resumeKey.isEmpty()) {
+        PartialTransferJournal::remove(m_resumeKey);
+        m_file->remove();
+        return;
+    }
+
     if (m_destination.isLocalFile() && QFile::exists(m_destination.toLocalFile())) {
         QFile::remove(m_destination.toLocalFile());
     }
@@ -137,6 +623,10 @@ bool FileTransferJob::doKill()
     if (m_reply) {
         m_reply->close();
     }
+    if (m_file) {
+        m_origin->disconnect(this);
+        m_file->close();
+    }
     if (m_origin) {
         m_origin->close();
     }
@@ -11,6 +11,7 @@
 #include <KJob>
 
 #include <QElapsedTimer>
+#include <QFile>
 #include <QIODevice>
 #include <QNetworkReply>
 #include <QSharedPointer>
@@ -18,18 +19,28 @@
 
 #include "kdeconnectcore_export.h"
 
+class ChecksumTrailerDevice;
 class NetworkPacket;
+class PayloadHasher;
+class RangedPayload;
 /**
  * @short It will stream a device into a url destination
  *
- * Given a QIODevice, the file transfer job will use the system's QNetworkAccessManager
- * for putting the stream into the requested location.
+ * Given a QIODevice, the file transfer job will write local destinations directly to disk
+ * and use the system's QNetworkAccessManager for putting the stream into remote locations.
  */
 class KDECONNECTCORE_EXPORT FileTransferJob : public KJob
 {
     Q_OBJECT
 
 public:
+    // Error codes of our own, besides the KIO and QNetworkReply ones
+    enum {
+        DestinationExistsError = 2,
+        IncompleteTransferError = 3,
+        ChecksumMismatchError = 5,
+    };
+
     /**
      * @p origin specifies the data to read from.
      * @p size specifies the expected size of the stream we're reading.
@@ -49,6 +60,29 @@ public:
     {
         m_autoRename = autoRename;
     }
+    /**
+     * Identifies the sender of resumable payloads, so interrupted transfers only continue
+     * with the same file coming from the same device.
+     */
+    void setSourceDeviceId(const QString &deviceId)
+    {
+        m_sourceDeviceId = deviceId;
+    }
+    /**
+     * A local file with the same contents as the payload. If the sender lets us skip
+     * the payload, the destination is copied from it instead.
+     */
+    void setCopySource(const QString &path)
+    {
+        m_copySource = path;
+    }
+    /**
+     * The checksum of the whole file, if the sender provided one and it matched what we received
+     */
+    QByteArray checksum() const
+    {
+        return m_verifiedChecksum;
+    }
     const NetworkPacket *networkPacket()
     {
         return m_np;
@@ -56,18 +90,37 @@ public:
 
 private Q_SLOTS:
     void doStart();
+    void readFromOrigin();
+    void originFinished();
+    void uploadFinished();
+    void verifyChecksum(const QByteArray &checksum);
 
 protected:
     bool doKill() override;
 
 private:
     void startTransfer();
+    void startLocalTransfer();
+    void startCopy();
+    bool cloneCopySource();
+    void finishLocalTransfer();
+    void completeLocalTransfer();
+    qint64 originBytesAvailable() const;
+    bool isResumable() const;
+    void requestPayload(qint64 offset);
+    QString partFilePath() const;
+    bool commitPartFile();
     void transferFailed(QNetworkReply::NetworkError error);
     void transferFinished();
     void deleteDestinationFile();
 
     QSharedPointer<QIODevice> m_origin;
+    // Set when the origin delivers its data in several ranges that can be written as they arrive
+    RangedPayload *m_rangedOrigin;
     QNetworkReply *m_reply;
+    QFile *m_file;
+    QByteArray m_buffer;
+    bool m_originFinished;
     QString m_from;
     QUrl m_destination;
     QElapsedTimer m_timer;
@@ -75,6 +128,25 @@ private:
     qint64 m_size;
     const NetworkPacket *m_np;
     bool m_autoRename;
+    QString m_sourceDeviceId;
+    // Set while receiving into a partial file that is kept if the transfer gets interrupted
+    QString m_resumeKey;
+    qint64 m_resumeOffset;
+    qint64 m_journaled;
+    // Set when the sender follows the payload with a checksum
+    PayloadHasher *m_hasher;
+    // Hashes the payload on its way to a non-local destination
+    ChecksumTrailerDevice *m_checksumDevice;
+    QByteArray m_expectedChecksum;
+    bool m_checksumReceived;
+    QByteArray m_verifiedChecksum;
+    QString m_copySource;
+
+    constexpr static qint64 CHUNK_SIZE = 256 * 1024;
+    // Upper bound of chunks written per event loop iteration, so local origins don't block the event loop
+    constexpr static int MAX_CHUNKS_PER_ITERATION = 16;
+    // How often the progress of a resumable transfer gets recorded, in case we don't get to do it at the end
+    constexpr static qint64 JOURNAL_INTERVAL = 16 * 1024 * 1024;
 };
 
 #endif
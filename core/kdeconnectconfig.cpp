@@ -16,6 +16,7 @@
 #include <QHostInfo>
 #include <QSettings>
 #include <QSslCertificate>
+#include <QSslKey>
 #include <QStandardPaths>
 #include <QThread>
 #include <QUuid>
@@ -24,6 +25,7 @@
 #include "daemon.h"
 #include "dbushelper.h"
 #include "deviceinfo.h"
+#include "linkcapabilities.h"
 #include "pluginloader.h"
 #include "sslhelper.h"
 
@@ -35,6 +37,8 @@ struct KdeConnectConfigPrivate {
 
     QSettings *m_config;
     QSettings *m_trustedDevices;
+    quint64 m_trustedDevicesRevision = 0;
+    quint64 m_identityRevision = 0;
 
 #ifdef Q_OS_MAC
     QString m_privateDBusAddress; // Private DBus Address cache
@@ -117,17 +121,32 @@ QSslCertificate KdeConnectConfig::certificate()
     return d->m_certificate;
 }
 
+QSslKey KdeConnectConfig::privateKey()
+{
+    return d->m_privateKey;
+}
+
+quint64 KdeConnectConfig::identityRevision() const
+{
+    return d->m_identityRevision;
+}
+
 DeviceInfo KdeConnectConfig::deviceInfo()
 {
     const auto incoming = PluginLoader::instance()->incomingCapabilities();
     const auto outgoing = PluginLoader::instance()->outgoingCapabilities();
+    QSet<QString> linkCapabilities = LinkCapabilities::supported();
+    if (multiplexedLinks()) {
+        linkCapabilities.insert(LINK_CAPABILITY_MULTIPLEXED_LINK);
+    }
     return DeviceInfo(deviceId(),
                       certificate(),
                       name(),
                       deviceType(),
                       NetworkPacket::s_protocolVersion,
                       QSet(incoming.begin(), incoming.end()),
-                      QSet(outgoing.begin(), outgoing.end()));
+                      QSet(outgoing.begin(), outgoing.end()),
+                      linkCapabilities);
 }
 
 QDir KdeConnectConfig::baseConfigDir()
@@ -152,6 +171,7 @@ void KdeConnectConfig::addTrustedDevice(const DeviceInfo &deviceInfo)
     d->m_trustedDevices->setValue(QStringLiteral("certificate"), certString);
     d->m_trustedDevices->endGroup();
     d->m_trustedDevices->sync();
+    d->m_trustedDevicesRevision++;
 
     QDir().mkpath(deviceConfigDir(deviceInfo.id).path());
 }
@@ -178,6 +198,11 @@ QSslCertificate KdeConnectConfig::getTrustedDeviceCertificate(const QString &id)
     return QSslCertificate(certString.toLatin1());
 }
 
+quint64 KdeConnectConfig::trustedDevicesRevision() const
+{
+    return d->m_trustedDevicesRevision;
+}
+
 DeviceInfo KdeConnectConfig::getTrustedDevice(const QString &id)
 {
     d->m_trustedDevices->beginGroup(id);
@@ -197,6 +222,7 @@ void KdeConnectConfig::removeTrustedDevice(const QString &deviceId)
 {
     d->m_trustedDevices->remove(deviceId);
     d->m_trustedDevices->sync();
+    d->m_trustedDevicesRevision++;
     // We do not remove the config files.
 }
 
@@ -233,6 +259,39 @@ QStringList KdeConnectConfig::customDevices() const
     return d->m_config->value(QStringLiteral("customDevices")).toStringList();
 }
 
+void KdeConnectConfig::setParallelPayloadStreams(int streams)
+{
+    d->m_config->setValue(QStringLiteral("parallelPayloadStreams"), streams);
+    d->m_config->sync();
+}
+
+int KdeConnectConfig::parallelPayloadStreams() const
+{
+    return qMax(1, d->m_config->value(QStringLiteral("parallelPayloadStreams"), 1).toInt());
+}
+
+void KdeConnectConfig::setEcIdentityKeys(bool ec)
+{
+    d->m_config->setValue(QStringLiteral("ecIdentityKeys"), ec);
+    d->m_config->sync();
+}
+
+bool KdeConnectConfig::ecIdentityKeys() const
+{
+    return d->m_config->value(QStringLiteral("ecIdentityKeys"), false).toBool();
+}
+
+void KdeConnectConfig::setMultiplexedLinks(bool multiplexed)
+{
+    d->m_config->setValue(QStringLiteral("multiplexedLinks"), multiplexed);
+    d->m_config->sync();
+}
+
+bool KdeConnectConfig::multiplexedLinks() const
+{
+    return d->m_config->value(QStringLiteral("multiplexedLinks"), false).toBool();
+}
+
 QDir KdeConnectConfig::deviceConfigDir(const QString &deviceId)
 {
     QString deviceConfigPath = baseConfigDir().absoluteFilePath(deviceId);
@@ -250,7 +309,7 @@ bool KdeConnectConfig::loadPrivateKey(const QString &keyPath)
 {
     QFile privKey(keyPath);
     if (privKey.exists() && privKey.open(QIODevice::ReadOnly)) {
-        d->m_privateKey = QSslKey(privKey.readAll(), QSsl::KeyAlgorithm::Rsa);
+        d->m_privateKey = SslHelper::readPrivateKey(privKey.readAll());
         if (d->m_privateKey.isNull()) {
             qCWarning(KDECONNECT_CORE) << "Private key from" << keyPath << "is not valid!";
         }
@@ -295,7 +354,9 @@ void KdeConnectConfig::generatePrivateKey(const QString &keyPath)
 {
     qCDebug(KDECONNECT_CORE) << "Generating private key";
 
-    d->m_privateKey = SslHelper::generateRsaPrivateKey();
+    // RSA unless EC keys were asked for, see ecIdentityKeys()
+    d->m_privateKey = SslHelper::generatePrivateKey(ecIdentityKeys() ? QSsl::Ec : QSsl::Rsa);
+    d->m_identityRevision++;
     if (d->m_privateKey.isNull()) {
         qCritical() << "Could not generate the private key";
         Daemon::instance()->reportError(i18n("KDE Connect failed to start"), i18n("Could not generate the private key."));
@@ -327,6 +388,7 @@ void KdeConnectConfig::generateCertificate(const QString &certPath)
     qCDebug(KDECONNECT_CORE) << "My id:" << uuid;
 
     d->m_certificate = SslHelper::generateSelfSignedCertificate(d->m_privateKey, uuid);
+    d->m_identityRevision++;
     if (d->m_certificate.isNull()) {
         qCritical() << "Could not generate a certificate";
         Daemon::instance()->reportError(i18n("KDE Connect failed to start"), i18n("Could not generate the device certificate."));
@@ -13,6 +13,7 @@
 #include "kdeconnectcore_export.h"
 
 class QSslCertificate;
+class QSslKey;
 
 class KDECONNECTCORE_EXPORT KdeConnectConfig
 {
@@ -27,6 +28,9 @@ public:
     QString name();
     DeviceType deviceType();
     QSslCertificate certificate();
+    QSslKey privateKey();
+    // Changes every time the private key or the certificate is replaced
+    quint64 identityRevision() const;
     DeviceInfo deviceInfo();
     QString privateKeyPath();
     QString certificatePath();
@@ -43,6 +47,8 @@ public:
     void updateTrustedDeviceInfo(const DeviceInfo &deviceInfo);
     DeviceInfo getTrustedDevice(const QString &id);
     QSslCertificate getTrustedDeviceCertificate(const QString &id);
+    // Changes every time a device is added or removed, to tell when something derived from the trusted certificates is stale
+    quint64 trustedDevicesRevision() const;
 
     void setDeviceProperty(const QString &deviceId, const QString &name, const QString &value);
     QString getDeviceProperty(const QString &deviceId, const QString &name, const QString &defaultValue = QString());
@@ -51,6 +57,22 @@ public:
     void setCustomDevices(const QStringList &addresses);
     QStringList customDevices() const;
 
+    // Connections used to send a single large payload, 1 disables parallel transfers.
+    // They are all served from the daemon's thread, so this helps with links that throttle each connection, not with a
+    // busy CPU.
+    void setParallelPayloadStreams(int streams);
+    int parallelPayloadStreams() const;
+
+    // Whether a new identity gets a P-256 key instead of an RSA one. Cheaper handshakes, but peers without ECDSA cipher suites
+    // can't connect to it. An existing identity is never replaced: trusted devices have its certificate pinned.
+    void setEcIdentityKeys(bool ec);
+    bool ecIdentityKeys() const;
+
+    // Whether links to trusted devices that want it as well carry their payloads over the link connection, see ConnectionMultiplexer.
+    // Payload streams, parallel transfers and pooled payload connections aren't used on those links.
+    void setMultiplexedLinks(bool multiplexed);
+    bool multiplexedLinks() const;
+
     /*
      * Paths for config files, there is no guarantee the directories already exist
      */
@@ -0,0 +1,53 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef LINKCAPABILITIES_H
+#define LINKCAPABILITIES_H
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+
+/**
+ * Optional transport features, advertised in the "linkCapabilities" field of the identity packet.
+ *
+ * A feature is only used when both ends advertise it, peers that don't send the field get the plain protocol.
+ */
+
+// Several framed payloads are sent back to back over a single payload connection
+#define LINK_CAPABILITY_PAYLOAD_STREAM QStringLiteral("payloadStream")
+// A large payload can be split in ranges sent over several payload connections at once
+#define LINK_CAPABILITY_PARALLEL_PAYLOAD QStringLiteral("parallelPayload")
+// The receiver asks for large payloads with a request line, and can continue an interrupted transfer
+#define LINK_CAPABILITY_PAYLOAD_RESUME QStringLiteral("payloadResume")
+// Payloads are followed by a checksum of the bytes sent, see PayloadHasher
+#define LINK_CAPABILITY_PAYLOAD_CHECKSUM QStringLiteral("payloadChecksum")
+// Large shared files carry a "contentHash", receivers that have the file already skip the payload
+#define LINK_CAPABILITY_CONTENT_HASH QStringLiteral("contentHash")
+// Packets on the device link may be sent as length prefixed CBOR instead of JSON lines
+#define LINK_CAPABILITY_CBOR_PACKETS QStringLiteral("cborPackets")
+// Packets and payloads share the device link connection, split in channels by ConnectionMultiplexer.
+// Only advertised when enabled in KdeConnectConfig, and only used with trusted devices: the TLS handshake has to agree on it as well, see
+// LINK_MULTIPLEXED_LINK_ALPN.
+#define LINK_CAPABILITY_MULTIPLEXED_LINK QStringLiteral("multiplexedLink")
+
+// The ALPN protocol both ends offer in the device link's TLS handshake when they want to multiplex it with the other one
+#define LINK_MULTIPLEXED_LINK_ALPN QByteArrayLiteral("kdeconnect-multiplexed")
+
+namespace LinkCapabilities
+{
+inline QSet<QString> supported()
+{
+    return {LINK_CAPABILITY_PAYLOAD_STREAM,
+            LINK_CAPABILITY_PARALLEL_PAYLOAD,
+            LINK_CAPABILITY_PAYLOAD_RESUME,
+            LINK_CAPABILITY_PAYLOAD_CHECKSUM,
+            LINK_CAPABILITY_CONTENT_HASH,
+            LINK_CAPABILITY_CBOR_PACKETS};
+}
+}
+
+#endif // LINKCAPABILITIES_H
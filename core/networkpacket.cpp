@@ -8,12 +8,13 @@
 #include "core_debug.h"
 
 #include <QByteArray>
+#include <QCborMap>
+#include <QCborValue>
 #include <QDataStream>
 #include <QDateTime>
 #include <QDebug>
 #include <QJsonDocument>
-#include <QMetaObject>
-#include <QMetaProperty>
+#include <QJsonObject>
 
 #include "dbushelper.h"
 #include "filetransferjob.h"
@@ -69,47 +70,76 @@ QByteArray NetworkPacket::serialize() const
     return json;
 }
 
-template<class T>
-void qvariant2qobject(const QVariantMap &variant, T *object)
+bool NetworkPacket::unserialize(const QByteArray &a, NetworkPacket *np)
 {
-    for (QVariantMap::const_iterator iter = variant.begin(); iter != variant.end(); ++iter) {
-        const int propertyIndex = T::staticMetaObject.indexOfProperty(iter.key().toLatin1().data());
-        if (propertyIndex < 0) {
-            qCWarning(KDECONNECT_CORE) << "missing property" << object << iter.key();
-            continue;
-        }
-
-        QMetaProperty property = T::staticMetaObject.property(propertyIndex);
-        bool ret = property.writeOnGadget(object, *iter);
-        if (!ret) {
-            qCWarning(KDECONNECT_CORE) << "couldn't set" << object << "->" << property.name() << '=' << *iter;
-        }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(a, &parseError);
+    if (!document.isObject()) {
+        qCDebug(KDECONNECT_CORE) << "Unserialization error:" << parseError.errorString();
+        return false;
+    }
+
+    // Fill the fields straight from the object, only the body and the transfer info end up as variant maps.
+    // Some clients send the id as a number, toVariant() takes care of both.
+    const QJsonObject object = document.object();
+    const QJsonValue id = object.value(QStringLiteral("id"));
+    if (!id.isUndefined()) {
+        np->m_id = id.toVariant().toString();
     }
+    np->m_type = object.value(QStringLiteral("type")).toString();
+    np->m_body = object.value(QStringLiteral("body")).toObject().toVariantMap();
+    np->m_payloadSize = object.value(QStringLiteral("payloadSize")).toInteger();
+    np->m_payloadTransferInfo = object.value(QStringLiteral("payloadTransferInfo")).toObject().toVariantMap(); // Empty if not present, which is ok
+
+    np->filterDeviceId();
+
+    return true;
 }
 
-bool NetworkPacket::unserialize(const QByteArray &a, NetworkPacket *np)
+QByteArray NetworkPacket::serializeCbor() const
 {
-    // Json -> QVariant
-    QJsonParseError parseError;
-    auto parser = QJsonDocument::fromJson(a, &parseError);
-    if (parser.isNull()) {
+    QCborMap map;
+    map.insert(QStringLiteral("id"), m_id);
+    map.insert(QStringLiteral("type"), m_type);
+    map.insert(QStringLiteral("body"), QCborMap::fromVariantMap(m_body));
+
+    if (hasPayload()) {
+        map.insert(QStringLiteral("payloadSize"), m_payloadSize);
+        map.insert(QStringLiteral("payloadTransferInfo"), QCborMap::fromVariantMap(m_payloadTransferInfo));
+    }
+
+    return map.toCborValue().toCbor();
+}
+
+bool NetworkPacket::unserializeCbor(const QByteArray &a, NetworkPacket *np)
+{
+    QCborParserError parseError;
+    const QCborValue value = QCborValue::fromCbor(a, &parseError);
+    if (parseError.error != QCborError::NoError || !value.isMap()) {
         qCDebug(KDECONNECT_CORE) << "Unserialization error:" << parseError.errorString();
         return false;
     }
 
-    auto variant = parser.toVariant().toMap();
-    qvariant2qobject(variant, np);
+    const QCborMap map = value.toMap();
+    np->m_id = map.value(QStringLiteral("id")).toVariant().toString();
+    np->m_type = map.value(QStringLiteral("type")).toString();
+    np->m_body = map.value(QStringLiteral("body")).toMap().toVariantMap();
+    np->m_payloadSize = map.value(QStringLiteral("payloadSize")).toInteger();
+    np->m_payloadTransferInfo = map.value(QStringLiteral("payloadTransferInfo")).toMap().toVariantMap();
 
-    np->m_payloadTransferInfo = variant[QStringLiteral("payloadTransferInfo")].toMap(); // Will return an empty qvariantmap if was not present, which is ok
+    np->filterDeviceId();
 
+    return true;
+}
+
+void NetworkPacket::filterDeviceId()
+{
     // Ids containing characters that are not allowed as dbus paths would make app crash
-    if (np->m_body.contains(QStringLiteral("deviceId"))) {
-        QString deviceId = np->get<QString>(QStringLiteral("deviceId"));
+    if (m_body.contains(QStringLiteral("deviceId"))) {
+        QString deviceId = get<QString>(QStringLiteral("deviceId"));
         DBusHelper::filterNonExportableCharacters(deviceId);
-        np->set(QStringLiteral("deviceId"), deviceId);
+        set(QStringLiteral("deviceId"), deviceId);
     }
-
-    return true;
 }
 
 FileTransferJob *NetworkPacket::createPayloadTransferJob(const QUrl &destination) const
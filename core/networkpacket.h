@@ -39,6 +39,10 @@ public:
     QByteArray serialize() const;
     static bool unserialize(const QByteArray &json, NetworkPacket *out);
 
+    // Same fields as the JSON form, encoded as a CBOR map. Not newline terminated, links using it need their own framing.
+    QByteArray serializeCbor() const;
+    static bool unserializeCbor(const QByteArray &cbor, NetworkPacket *out);
+
     inline QString id() const
     {
         return m_id;
@@ -103,6 +107,8 @@ public:
     }
 
 private:
+    void filterDeviceId();
+
     QString m_id;
     QString m_type;
     QVariantMap m_body;
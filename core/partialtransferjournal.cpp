@@ -0,0 +1,79 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "partialtransferjournal.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+
+// Partial files nobody came back for are forgotten after this long
+static const qint64 MAX_ENTRY_AGE_SECS = 7 * 24 * 60 * 60;
+
+QString PartialTransferJournal::key(const QString &deviceId, const QString &fileName, qint64 size, qint64 lastModified)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(deviceId.toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(fileName.toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QByteArray::number(size));
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QByteArray::number(lastModified));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+PartialTransferJournal::Entry PartialTransferJournal::lookup(const QString &key)
+{
+    QSettings journal(journalPath(), QSettings::IniFormat);
+    journal.beginGroup(key);
+    Entry entry;
+    entry.partPath = journal.value(QStringLiteral("partPath")).toString();
+    entry.committed = journal.value(QStringLiteral("committed"), 0).toLongLong();
+    const qint64 updated = journal.value(QStringLiteral("updated"), 0).toLongLong();
+    journal.endGroup();
+
+    if (entry.partPath.isEmpty()) {
+        return Entry();
+    }
+
+    // The partial file is allocated at its full size up front, so its size says nothing about what was received
+    const bool expired = QDateTime::currentSecsSinceEpoch() - updated > MAX_ENTRY_AGE_SECS;
+    if (expired) {
+        QFile::remove(entry.partPath);
+    }
+    if (expired || !QFileInfo(entry.partPath).isFile() || entry.committed <= 0) {
+        journal.remove(key);
+        return Entry();
+    }
+    return entry;
+}
+
+void PartialTransferJournal::store(const QString &key, const Entry &entry)
+{
+    QSettings journal(journalPath(), QSettings::IniFormat);
+    journal.beginGroup(key);
+    journal.setValue(QStringLiteral("partPath"), entry.partPath);
+    journal.setValue(QStringLiteral("committed"), entry.committed);
+    journal.setValue(QStringLiteral("updated"), QDateTime::currentSecsSinceEpoch());
+    journal.endGroup();
+}
+
+void PartialTransferJournal::remove(const QString &key)
+{
+    QSettings journal(journalPath(), QSettings::IniFormat);
+    journal.remove(key);
+}
+
+QString PartialTransferJournal::journalPath()
+{
+    const QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    return cacheDir.absoluteFilePath(QStringLiteral("partial-transfers"));
+}
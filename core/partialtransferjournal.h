@@ -0,0 +1,42 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef PARTIALTRANSFERJOURNAL_H
+#define PARTIALTRANSFERJOURNAL_H
+
+#include <QString>
+
+#include "kdeconnectcore_export.h"
+
+/**
+ * Remembers interrupted incoming transfers, so they can continue where they stopped
+ * when the same file gets sent again.
+ *
+ * Entries are keyed by the sending device and the identity of the file (name, size and
+ * modification time), and point to the partial file holding the bytes received so far.
+ */
+class KDECONNECTCORE_EXPORT PartialTransferJournal
+{
+public:
+    struct Entry {
+        QString partPath;
+        qint64 committed = 0;
+    };
+
+    static QString key(const QString &deviceId, const QString &fileName, qint64 size, qint64 lastModified);
+
+    /**
+     * Returns an empty entry if nothing usable was recorded for @p key
+     */
+    static Entry lookup(const QString &key);
+    static void store(const QString &key, const Entry &entry);
+    static void remove(const QString &key);
+
+private:
+    static QString journalPath();
+};
+
+#endif // PARTIALTRANSFERJOURNAL_H
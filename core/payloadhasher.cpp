@@ -0,0 +1,101 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "payloadhasher.h"
+
+#include <QThread>
+
+PayloadHasher::PayloadHasher(QObject *parent)
+    : QObject(parent)
+    , m_hash(QCryptographicHash::Blake2b_256)
+    , m_bytesAdded(0)
+    , m_bytesPending(0)
+    , m_thread(nullptr)
+    , m_worker(nullptr)
+{
+}
+
+PayloadHasher::~PayloadHasher()
+{
+    if (m_thread) {
+        m_thread->quit();
+        m_thread->wait();
+        delete m_worker;
+    }
+}
+
+QString PayloadHasher::algorithmName()
+{
+    return QStringLiteral("blake2b-256");
+}
+
+void PayloadHasher::addData(const QByteArray &data)
+{
+    m_bytesAdded += data.size();
+    if (!m_thread && m_bytesAdded <= INLINE_HASH_LIMIT) {
+        m_hash.addData(data);
+        return;
+    }
+
+    if (!m_thread) {
+        m_thread = new QThread(this);
+        m_thread->setObjectName(QStringLiteral("PayloadHasher"));
+        m_worker = new QObject;
+        m_worker->moveToThread(m_thread);
+        m_thread->start();
+    }
+
+    // Queued calls run in order, and m_hash is only touched from the worker thread from now on
+    m_bytesPending += data.size();
+    QMetaObject::invokeMethod(
+        m_worker,
+        [this, data]() {
+            m_hash.addData(data);
+            const qint64 bytes = data.size();
+            QMetaObject::invokeMethod(
+                this,
+                [this, bytes]() {
+                    m_bytesPending -= bytes;
+                    Q_EMIT bytesHashed(bytes);
+                },
+                Qt::QueuedConnection);
+        },
+        Qt::QueuedConnection);
+}
+
+qint64 PayloadHasher::bytesPending() const
+{
+    return m_bytesPending;
+}
+
+void PayloadHasher::finish()
+{
+    if (!m_thread) {
+        const QByteArray result = m_hash.result();
+        QMetaObject::invokeMethod(
+            this,
+            [this, result]() {
+                Q_EMIT finished(result);
+            },
+            Qt::QueuedConnection);
+        return;
+    }
+
+    QMetaObject::invokeMethod(
+        m_worker,
+        [this]() {
+            const QByteArray result = m_hash.result();
+            QMetaObject::invokeMethod(
+                this,
+                [this, result]() {
+                    Q_EMIT finished(result);
+                },
+                Qt::QueuedConnection);
+        },
+        Qt::QueuedConnection);
+}
+
+#include "moc_payloadhasher.cpp"
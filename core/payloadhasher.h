@@ -0,0 +1,61 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef PAYLOADHASHER_H
+#define PAYLOADHASHER_H
+
+#include <QCryptographicHash>
+#include <QObject>
+
+#include "kdeconnectcore_export.h"
+
+class QThread;
+
+/**
+ * Computes the checksum of a payload while it is being transferred.
+ *
+ * Small payloads are hashed right away, once more than INLINE_HASH_LIMIT bytes have been added
+ * the rest is hashed on a worker thread so the event loop never waits for it.
+ */
+class KDECONNECTCORE_EXPORT PayloadHasher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PayloadHasher(QObject *parent = nullptr);
+    ~PayloadHasher() override;
+
+    /**
+     * If @p data doesn't own its bytes (QByteArray::fromRawData) they have to stay valid until finished() is emitted
+     */
+    void addData(const QByteArray &data);
+    void finish();
+    /**
+     * Bytes added but not hashed yet, the worker thread's backlog
+     */
+    qint64 bytesPending() const;
+
+    // Name of the algorithm in the payload transfer info
+    static QString algorithmName();
+
+    constexpr static int HASH_SIZE = 32;
+    constexpr static qint64 INLINE_HASH_LIMIT = 1024 * 1024;
+
+Q_SIGNALS:
+    void finished(const QByteArray &hash);
+    // Part of the backlog was hashed
+    void bytesHashed(qint64 bytes);
+
+private:
+    QCryptographicHash m_hash;
+    qint64 m_bytesAdded;
+    qint64 m_bytesPending;
+    QThread *m_thread;
+    // Lives in m_thread, to queue work on it
+    QObject *m_worker;
+};
+
+#endif // PAYLOADHASHER_H
@@ -0,0 +1,36 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#ifndef RANGEDPAYLOAD_H
+#define RANGEDPAYLOAD_H
+
+#include <QtGlobal>
+
+/**
+ * Implemented by payload devices whose data arrives as several independent ranges.
+ *
+ * Reading the device with QIODevice::read() returns the payload in order, which stalls on
+ * whichever range is the slowest. Consumers that can write at arbitrary positions should
+ * use readAnyRange() instead. Don't mix both ways of reading on the same payload.
+ */
+class RangedPayload
+{
+public:
+    virtual ~RangedPayload() = default;
+
+    /**
+     * Bytes that readAnyRange() can return without blocking
+     */
+    virtual qint64 rangeBytesAvailable() const = 0;
+
+    /**
+     * Reads up to @p maxlen bytes from any range with data available.
+     * @p offset is set to the position of those bytes within the payload.
+     */
+    virtual qint64 readAnyRange(char *data, qint64 maxlen, qint64 *offset) = 0;
+};
+
+#endif // RANGEDPAYLOAD_H
@@ -10,8 +10,10 @@
 
 extern "C" {
 #include <openssl/bn.h>
+#include <openssl/ec.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/obj_mac.h>
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
 #include <openssl/x509.h>
@@ -26,59 +28,79 @@ QString getSslError()
     return QString::fromLatin1(buf);
 }
 
-QSslKey generateRsaPrivateKey()
+QSslKey generatePrivateKey(QSsl::KeyAlgorithm algorithm)
 {
+    Q_ASSERT(algorithm == QSsl::Rsa || algorithm == QSsl::Ec);
+
     // Initialize context.
-    auto pctxRaw = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+    auto pctxRaw = EVP_PKEY_CTX_new_id(algorithm == QSsl::Ec ? EVP_PKEY_EC : EVP_PKEY_RSA, nullptr);
     auto pctx = std::unique_ptr<EVP_PKEY_CTX, decltype(&::EVP_PKEY_CTX_free)>(pctxRaw, ::EVP_PKEY_CTX_free);
     if (!pctx) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed to allocate context " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to allocate context " << getSslError();
         return QSslKey();
     }
 
     if (EVP_PKEY_keygen_init(pctx.get()) <= 0) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed to initialize context " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to initialize context " << getSslError();
         return QSslKey();
     }
 
-    // Set key bits.
-    if (EVP_PKEY_CTX_set_rsa_keygen_bits(pctx.get(), 2048) <= 0) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed to set key bits " << getSslError();
-        return QSslKey();
+    if (algorithm == QSsl::Ec) {
+        // Set curve, P-256 is the one every TLS implementation supports.
+        if (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx.get(), NID_X9_62_prime256v1) <= 0) {
+            qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to set curve " << getSslError();
+            return QSslKey();
+        }
+    } else {
+        // Set key bits.
+        if (EVP_PKEY_CTX_set_rsa_keygen_bits(pctx.get(), 2048) <= 0) {
+            qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to set key bits " << getSslError();
+            return QSslKey();
+        }
     }
 
     // Generate private key.
     auto pkey = std::unique_ptr<EVP_PKEY, decltype(&::EVP_PKEY_free)>(EVP_PKEY_new(), ::EVP_PKEY_free);
     if (!pkey) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed to allocate private key " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to allocate private key " << getSslError();
         return QSslKey();
     }
 
     auto pkey_raw = pkey.get();
     if (EVP_PKEY_keygen(pctx.get(), &pkey_raw) <= 0) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed to generate private key " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to generate private key " << getSslError();
         return QSslKey();
     }
 
     // Convert private key format to PEM as required by QSslKey.
     auto bio = std::unique_ptr<BIO, decltype(&::BIO_free_all)>(BIO_new(BIO_s_mem()), ::BIO_free_all);
     if (!bio) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed to allocate I/O abstraction " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed to allocate I/O abstraction " << getSslError();
         return QSslKey();
     }
 
     if (!PEM_write_bio_PrivateKey(bio.get(), pkey_raw, nullptr, nullptr, 0, nullptr, nullptr)) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed write PEM format private key to BIO " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed write PEM format private key to BIO " << getSslError();
         return QSslKey();
     }
 
     BUF_MEM *mem = nullptr;
     if (!BIO_get_mem_ptr(bio.get(), &mem)) {
-        qCWarning(KDECONNECT_CORE) << "Generate RSA Private Key failed get PEM format address " << getSslError();
+        qCWarning(KDECONNECT_CORE) << "Generate Private Key failed get PEM format address " << getSslError();
         return QSslKey();
     }
 
-    return QSslKey(QByteArray(mem->data, mem->length), QSsl::KeyAlgorithm::Rsa);
+    return QSslKey(QByteArray(mem->data, mem->length), algorithm);
+}
+
+QSslKey readPrivateKey(const QByteArray &pem)
+{
+    // QSslKey needs to be told the algorithm, and returns a null key if it doesn't match
+    QSslKey key(pem, QSsl::Ec);
+    if (key.isNull()) {
+        key = QSslKey(pem, QSsl::Rsa);
+    }
+    return key;
 }
 
 QSslCertificate generateSelfSignedCertificate(const QSslKey &qtPrivateKey, const QString &commonName)
@@ -11,10 +11,14 @@
 #include <QSslKey>
 #include <QString>
 
+#include "kdeconnectcore_export.h"
+
 namespace SslHelper
 {
-QSslKey generateRsaPrivateKey();
-QSslCertificate generateSelfSignedCertificate(const QSslKey &privateKey, const QString &commonName);
+// Supports QSsl::Rsa (2048 bits) and QSsl::Ec (P-256)
+KDECONNECTCORE_EXPORT QSslKey generatePrivateKey(QSsl::KeyAlgorithm algorithm);
+KDECONNECTCORE_EXPORT QSslKey readPrivateKey(const QByteArray &pem);
+KDECONNECTCORE_EXPORT QSslCertificate generateSelfSignedCertificate(const QSslKey &privateKey, const QString &commonName);
 }
 
 #endif
@@ -56,12 +56,7 @@ DevicesModel::~DevicesModel()
 
 int DevicesModel::rowForDevice(const QString &id) const
 {
-    for (int i = 0, c = m_deviceList.size(); i < c; ++i) {
-        if (m_deviceList[i]->id() == id) {
-            return i;
-        }
-    }
-    return -1;
+    return m_rowForDevice.value(id, -1);
 }
 
 void DevicesModel::deviceAdded(const QString &id)
@@ -88,9 +83,7 @@ void DevicesModel::deviceRemoved(const QString &id)
 {
     int row = rowForDevice(id);
     if (row >= 0) {
-        beginRemoveRows(QModelIndex(), row, row);
-        delete m_deviceList.takeAt(row);
-        endRemoveRows();
+        removeDevice(row);
     }
 }
 
@@ -110,9 +103,7 @@ void DevicesModel::deviceUpdated(const QString &id)
     } else {
         DeviceDbusInterface *dev = getDevice(row);
         if (!passesFilter(dev)) {
-            beginRemoveRows(QModelIndex(), row, row);
-            delete m_deviceList.takeAt(row);
-            endRemoveRows();
+            removeDevice(row);
             qCDebug(KDECONNECT_INTERFACES) << "Removed changed device " << id;
         } else {
             const QModelIndex idx = index(row);
@@ -177,6 +168,7 @@ void DevicesModel::receivedDeviceList(QDBusPendingCallWatcher *watcher)
 
 void DevicesModel::appendDevice(DeviceDbusInterface *dev)
 {
+    m_rowForDevice.insert(dev->id(), m_deviceList.size());
     m_deviceList.append(dev);
     connect(dev, &OrgKdeKdeconnectDeviceInterface::nameChanged, this, [this, dev]() {
         Q_ASSERT(rowForDevice(dev->id()) >= 0);
@@ -184,12 +176,26 @@ void DevicesModel::appendDevice(DeviceDbusInterface *dev)
     });
 }
 
+void DevicesModel::removeDevice(int row)
+{
+    beginRemoveRows(QModelIndex(), row, row);
+    DeviceDbusInterface *dev = m_deviceList.takeAt(row);
+    m_rowForDevice.remove(dev->id());
+    // The rows after it moved up by one
+    for (int i = row, c = m_deviceList.size(); i < c; ++i) {
+        m_rowForDevice[m_deviceList[i]->id()] = i;
+    }
+    delete dev;
+    endRemoveRows();
+}
+
 void DevicesModel::clearDevices()
 {
     if (!m_deviceList.isEmpty()) {
         beginRemoveRows(QModelIndex(), 0, m_deviceList.size() - 1);
         qDeleteAll(m_deviceList);
         m_deviceList.clear();
+        m_rowForDevice.clear();
         endRemoveRows();
     }
 }
@@ -72,10 +72,13 @@ Q_SIGNALS:
 private:
     void clearDevices();
     void appendDevice(DeviceDbusInterface *dev);
+    void removeDevice(int row);
     bool passesFilter(DeviceDbusInterface *dev) const;
 
     DaemonDbusInterface *m_dbusInterface;
     QVector<DeviceDbusInterface *> m_deviceList;
+    // Index of m_deviceList by device id
+    QHash<QString, int> m_rowForDevice;
     StatusFilterFlag m_displayFilter;
 };
 
@@ -0,0 +1,249 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include "contentindex.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include <cstring>
+
+#include "plugin_share_debug.h"
+
+static const quint32 INDEX_MAGIC = 0x4b434349; // "KCCI"
+static const quint32 INDEX_VERSION = 2;
+static const quint32 INITIAL_CAPACITY = 1024;
+
+ContentIndex::ContentIndex(const QString &path)
+    : m_path(path)
+    , m_header(nullptr)
+    , m_slots(nullptr)
+{
+    if (!open()) {
+        qCWarning(KDECONNECT_PLUGIN_SHARE) << "Could not open the content index at" << m_path;
+    }
+}
+
+ContentIndex::~ContentIndex()
+{
+    close();
+}
+
+ContentIndex &ContentIndex::instance()
+{
+    static ContentIndex index(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath(QStringLiteral("share-content-index")));
+    return index;
+}
+
+bool ContentIndex::open()
+{
+    QDir().mkpath(QFileInfo(m_path).path());
+
+    m_paths.setFileName(m_path + QStringLiteral(".paths"));
+    if (!m_paths.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    m_table.setFileName(m_path);
+    if (!m_table.exists() || m_table.size() < qint64(sizeof(Header))) {
+        return create(INITIAL_CAPACITY);
+    }
+
+    if (!m_table.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    uchar *map = m_table.map(0, m_table.size());
+    if (!map) {
+        m_table.close();
+        return false;
+    }
+
+    m_header = reinterpret_cast<Header *>(map);
+    const qint64 expectedSize = qint64(sizeof(Header)) + qint64(m_header->capacity) * qint64(sizeof(Slot));
+    if (m_header->magic != INDEX_MAGIC || m_header->version != INDEX_VERSION || m_header->capacity == 0
+        || (m_header->capacity & (m_header->capacity - 1)) != 0 || m_table.size() != expectedSize) {
+        qCDebug(KDECONNECT_PLUGIN_SHARE) << "Discarding unusable content index" << m_path;
+        close();
+        m_paths.resize(0);
+        return create(INITIAL_CAPACITY);
+    }
+    m_slots = reinterpret_cast<Slot *>(map + sizeof(Header));
+    return true;
+}
+
+bool ContentIndex::create(quint32 capacity)
+{
+    const qint64 size = qint64(sizeof(Header)) + qint64(capacity) * qint64(sizeof(Slot));
+
+    // Written next to the real one and renamed over it, so a crash never leaves a half written table behind
+    QFile table(m_path + QStringLiteral(".new"));
+    if (!table.open(QIODevice::ReadWrite | QIODevice::Truncate) || !table.resize(size)) {
+        return false;
+    }
+    uchar *map = table.map(0, size);
+    if (!map) {
+        return false;
+    }
+
+    Header *header = reinterpret_cast<Header *>(map);
+    std::memset(map, 0, size);
+    header->magic = INDEX_MAGIC;
+    header->version = INDEX_VERSION;
+    header->capacity = capacity;
+    header->count = 0;
+
+    // Carry over what the old table had
+    if (m_header) {
+        Slot *slots = reinterpret_cast<Slot *>(map + sizeof(Header));
+        for (quint32 i = 0; i < m_header->capacity; i++) {
+            const Slot &old = m_slots[i];
+            if (!old.used) {
+                continue;
+            }
+            quint64 start;
+            std::memcpy(&start, old.hash, sizeof(start));
+            for (quint32 j = 0; j < capacity; j++) {
+                Slot &slot = slots[(start + j) & (capacity - 1)];
+                if (!slot.used) {
+                    slot = old;
+                    header->count++;
+                    break;
+                }
+            }
+        }
+    }
+
+    table.unmap(map);
+    table.close();
+    close();
+
+    QFile::remove(m_path);
+    if (!QFile::rename(table.fileName(), m_path)) {
+        return false;
+    }
+
+    m_table.setFileName(m_path);
+    if (!m_table.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    map = m_table.map(0, size);
+    if (!map) {
+        m_table.close();
+        return false;
+    }
+    m_header = reinterpret_cast<Header *>(map);
+    m_slots = reinterpret_cast<Slot *>(map + sizeof(Header));
+    return true;
+}
+
+bool ContentIndex::grow()
+{
+    return create(m_header->capacity * 2);
+}
+
+void ContentIndex::close()
+{
+    if (m_header) {
+        m_table.unmap(reinterpret_cast<uchar *>(m_header));
+        m_header = nullptr;
+        m_slots = nullptr;
+    }
+    m_table.close();
+}
+
+QByteArray ContentIndex::slotKey(const QString &deviceId, const QByteArray &hash)
+{
+    // Slots hold this instead of the content hash, so the same file received from two devices has two unrelated entries
+    QCryptographicHash key(QCryptographicHash::Blake2b_256);
+    key.addData(deviceId.toUtf8());
+    key.addData(QByteArrayView("\0", 1));
+    key.addData(hash);
+    return key.result();
+}
+
+ContentIndex::Slot *ContentIndex::findSlot(const QByteArray &key, qint64 size) const
+{
+    // The key is uniformly distributed already, its first bytes make a good bucket index
+    quint64 start;
+    std::memcpy(&start, key.constData(), sizeof(start));
+
+    const quint32 mask = m_header->capacity - 1;
+    for (quint32 i = 0; i < m_header->capacity; i++) {
+        Slot *slot = &m_slots[(start + i) & mask];
+        if (!slot->used || (slot->size == size && std::memcmp(slot->hash, key.constData(), HASH_SIZE) == 0)) {
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+QString ContentIndex::readPath(const Slot *slot)
+{
+    if (!m_paths.seek(slot->pathOffset)) {
+        return QString();
+    }
+    return QString::fromUtf8(m_paths.read(slot->pathLength));
+}
+
+QString ContentIndex::lookup(const QString &deviceId, const QByteArray &hash, qint64 size)
+{
+    if (!m_header || hash.size() != HASH_SIZE) {
+        return QString();
+    }
+
+    const Slot *slot = findSlot(slotKey(deviceId, hash), size);
+    if (!slot || !slot->used) {
+        return QString();
+    }
+
+    const QString filePath = readPath(slot);
+    const QFileInfo fileInfo(filePath);
+    if (!fileInfo.isFile() || fileInfo.size() != size || fileInfo.lastModified().toMSecsSinceEpoch() != slot->lastModified) {
+        // Moved, deleted or changed since we received it
+        return QString();
+    }
+    return filePath;
+}
+
+void ContentIndex::insert(const QString &deviceId, const QByteArray &hash, qint64 size, const QString &filePath)
+{
+    if (!m_header || hash.size() != HASH_SIZE) {
+        return;
+    }
+
+    // Keep the table at most 3/4 full, so probe sequences stay short
+    if ((m_header->count + 1) * 4 > m_header->capacity * 3 && !grow()) {
+        qCWarning(KDECONNECT_PLUGIN_SHARE) << "Could not grow the content index";
+        return;
+    }
+
+    const QByteArray key = slotKey(deviceId, hash);
+    Slot *slot = findSlot(key, size);
+    if (!slot) {
+        return;
+    }
+
+    const QByteArray path = filePath.toUtf8();
+    const qint64 pathOffset = m_paths.size();
+    if (!m_paths.seek(pathOffset) || m_paths.write(path) != path.size()) {
+        qCWarning(KDECONNECT_PLUGIN_SHARE) << "Could not write to the content index" << m_paths.errorString();
+        return;
+    }
+    m_paths.flush();
+
+    if (!slot->used) {
+        std::memcpy(slot->hash, key.constData(), HASH_SIZE);
+        slot->size = size;
+        m_header->count++;
+    }
+    slot->lastModified = QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+    slot->pathOffset = pathOffset;
+    slot->pathLength = path.size();
+    slot->used = 1;
+}
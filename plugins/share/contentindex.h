@@ -0,0 +1,67 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#pragma once
+
+#include <QFile>
+#include <QString>
+
+/**
+ * Persistent index from the content hash of received files to where they were saved.
+ *
+ * Files are found by the device that sent them. Another device asking for a hash only ever
+ * learns about the files it sent us itself, not whether some file exists on this machine.
+ *
+ * The index is an open addressing hash table in a memory mapped file, so lookups don't
+ * need to load anything. Paths live in a second, append-only file. Entries are never
+ * removed, a lookup only returns files that still have the size and modification time
+ * they had when they were added.
+ */
+class ContentIndex
+{
+public:
+    explicit ContentIndex(const QString &path);
+    ~ContentIndex();
+
+    // One table for all devices, it must only be mapped once
+    static ContentIndex &instance();
+
+    QString lookup(const QString &deviceId, const QByteArray &hash, qint64 size);
+    void insert(const QString &deviceId, const QByteArray &hash, qint64 size, const QString &filePath);
+
+    constexpr static int HASH_SIZE = 32;
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 capacity;
+        quint32 count;
+    };
+
+    struct Slot {
+        char hash[HASH_SIZE];
+        qint64 size;
+        qint64 lastModified;
+        quint64 pathOffset;
+        quint32 pathLength;
+        quint32 used;
+    };
+
+    bool open();
+    bool create(quint32 capacity);
+    bool grow();
+    void close();
+    static QByteArray slotKey(const QString &deviceId, const QByteArray &hash);
+    Slot *findSlot(const QByteArray &key, qint64 size) const;
+    QString readPath(const Slot *slot);
+
+    const QString m_path;
+    QFile m_table;
+    QFile m_paths;
+    Header *m_header;
+    Slot *m_slots;
+};
@@ -26,6 +26,7 @@
 
 #include "core/daemon.h"
 #include "core/filetransferjob.h"
+#include "contentindex.h"
 #include "plugin_share_debug.h"
 
 K_PLUGIN_CLASS_WITH_JSON(SharePlugin, "kdeconnect_share.json")
@@ -128,6 +129,14 @@ void SharePlugin::receivePacket(const NetworkPacket &np)
             FileTransferJob *job = np.createPayloadTransferJob(destination);
             job->setOriginName(device()->name() + QStringLiteral(": ") + filename);
             job->setAutoRenameIfDestinatinonExists(true);
+            job->setSourceDeviceId(device()->id());
+            if (np.has(QStringLiteral("contentHash"))) {
+                const QByteArray hash = QByteArray::fromHex(np.get<QString>(QStringLiteral("contentHash")).toLatin1());
+                const QString copySource = ContentIndex::instance().lookup(device()->id(), hash, np.payloadSize());
+                if (!copySource.isEmpty()) {
+                    job->setCopySource(copySource);
+                }
+            }
             connect(job, &KJob::result, this, [this, dateCreated, dateModified, open](KJob *job) -> void {
                 finished(job, dateCreated, dateModified, open);
             });
@@ -227,6 +236,10 @@ void SharePlugin::finished(KJob *job, const qint64 dateModified, const qint64 da
         Q_EMIT shareReceived(ftjob->destination().toString());
         setDateCreated(ftjob->destination(), dateCreated);
         setDateModified(ftjob->destination(), dateModified);
+        // After the dates are set, the index remembers the final modification time
+        if (!ftjob->checksum().isEmpty()) {
+            ContentIndex::instance().insert(device()->id(), ftjob->checksum(), ftjob->totalAmount(KJob::Bytes), ftjob->destination().toLocalFile());
+        }
         qCDebug(KDECONNECT_PLUGIN_SHARE) << "File transfer finished." << ftjob->destination();
         if (open) {
             QDesktopServices::openUrl(ftjob->destination());
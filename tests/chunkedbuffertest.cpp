@@ -0,0 +1,113 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QTest>
+
+#include "core/backends/multiplexer/chunkedbuffer.h"
+
+// Larger than the chunk small appends are merged into, so each of these is a chunk of its own
+static const qint64 CHUNK_SIZE = 8192;
+
+class ChunkedBufferTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testReadAcrossChunks()
+    {
+        ChunkedBuffer buffer;
+        buffer.append(QByteArray(CHUNK_SIZE, 'a'));
+        buffer.append(QByteArray(CHUNK_SIZE, 'b'));
+        buffer.append(QByteArray(CHUNK_SIZE, 'c'));
+        QCOMPARE(buffer.size(), 3 * CHUNK_SIZE);
+
+        QCOMPARE(buffer.read(CHUNK_SIZE - 10), QByteArray(CHUNK_SIZE - 10, 'a'));
+        QCOMPARE(buffer.read(20), QByteArray(10, 'a') + QByteArray(10, 'b'));
+
+        char data[2 * CHUNK_SIZE];
+        QCOMPARE(buffer.read(data, sizeof(data)), 2 * CHUNK_SIZE - 10);
+        QCOMPARE(QByteArray(data, 2 * CHUNK_SIZE - 10), QByteArray(CHUNK_SIZE - 10, 'b') + QByteArray(CHUNK_SIZE, 'c'));
+        QVERIFY(buffer.isEmpty());
+        QCOMPARE(buffer.read(1), QByteArray());
+    }
+
+    void testReadWholeChunk()
+    {
+        ChunkedBuffer buffer;
+        const QByteArray chunk(CHUNK_SIZE, 'a');
+        buffer.append(chunk);
+        buffer.append(QByteArray(CHUNK_SIZE, 'b'));
+
+        // Handed out as it was appended, without a copy
+        const QByteArray result = buffer.read(CHUNK_SIZE);
+        QVERIFY(result.constData() == chunk.constData());
+        QCOMPARE(buffer.size(), CHUNK_SIZE);
+    }
+
+    void testSmallAppendsMerge()
+    {
+        ChunkedBuffer buffer;
+        for (char c = 'a'; c <= 'z'; c++) {
+            buffer.append(&c, 1);
+        }
+        buffer.append(QByteArrayLiteral("0123"));
+
+        QCOMPARE(buffer.nextBlockSize(), qint64(30));
+        QCOMPARE(QByteArray(buffer.readPointer(), buffer.nextBlockSize()), QByteArrayLiteral("abcdefghijklmnopqrstuvwxyz0123"));
+    }
+
+    void testFree()
+    {
+        ChunkedBuffer buffer;
+        buffer.append(QByteArray(CHUNK_SIZE, 'a'));
+        buffer.append(QByteArray(CHUNK_SIZE, 'b'));
+
+        buffer.free(10);
+        QCOMPARE(buffer.nextBlockSize(), CHUNK_SIZE - 10);
+        QCOMPARE(*buffer.readPointer(), 'a');
+
+        // Ends in the middle of the second chunk
+        buffer.free(CHUNK_SIZE);
+        QCOMPARE(buffer.size(), CHUNK_SIZE - 10);
+        QCOMPARE(buffer.nextBlockSize(), CHUNK_SIZE - 10);
+        QCOMPARE(*buffer.readPointer(), 'b');
+
+        buffer.free(2 * CHUNK_SIZE);
+        QVERIFY(buffer.isEmpty());
+        QCOMPARE(buffer.nextBlockSize(), qint64(0));
+        QVERIFY(!buffer.readPointer());
+    }
+
+    void testContains()
+    {
+        ChunkedBuffer buffer;
+        QByteArray first(CHUNK_SIZE, 'a');
+        first[0] = '\n';
+        buffer.append(first);
+        QByteArray second(CHUNK_SIZE, 'b');
+        second[CHUNK_SIZE - 1] = '\r';
+        buffer.append(second);
+
+        QVERIFY(buffer.contains('\n'));
+        QVERIFY(buffer.contains('\r'));
+        QVERIFY(!buffer.contains('c'));
+
+        // Bytes that were read already don't count
+        buffer.free(1);
+        QVERIFY(!buffer.contains('\n'));
+        buffer.free(CHUNK_SIZE);
+        QVERIFY(!buffer.contains('a'));
+        QVERIFY(buffer.contains('\r'));
+
+        buffer.clear();
+        QVERIFY(buffer.isEmpty());
+        QVERIFY(!buffer.contains('\r'));
+    }
+};
+
+QTEST_GUILESS_MAIN(ChunkedBufferTest)
+
+#include "chunkedbuffertest.moc"
@@ -0,0 +1,158 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QPointer>
+#include <QTest>
+
+#include "core/backends/lan/connectscheduler.h"
+
+/**
+ * Records the attempts a ConnectScheduler starts. The sockets never connect, the tests end the attempts by emitting
+ * the socket's signals.
+ */
+class Attempts : public QObject
+{
+public:
+    ConnectScheduler::StartFunction start(const QString &name)
+    {
+        return [this, name]() {
+            QSslSocket *socket = new QSslSocket(this);
+            started.append(name);
+            sockets.append(socket);
+            return socket;
+        };
+    }
+
+    QStringList started;
+    QList<QPointer<QSslSocket>> sockets;
+};
+
+static QHostAddress address(int i)
+{
+    return QHostAddress(QStringLiteral("192.0.2.%1").arg(i));
+}
+
+class ConnectSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testConcurrencyCap()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        for (int i = 0; i < ConnectScheduler::MAX_CONCURRENT_CONNECTS + 2; i++) {
+            QVERIFY(scheduler.schedule(QStringLiteral("device"), address(i), false, attempts.start(QString::number(i))));
+        }
+        QCOMPARE(attempts.started.size(), ConnectScheduler::MAX_CONCURRENT_CONNECTS);
+
+        Q_EMIT attempts.sockets[0]->encrypted();
+        QCOMPARE(attempts.started.size(), ConnectScheduler::MAX_CONCURRENT_CONNECTS + 1);
+        Q_EMIT attempts.sockets[1]->errorOccurred(QAbstractSocket::ConnectionRefusedError);
+        QCOMPARE(attempts.started.size(), ConnectScheduler::MAX_CONCURRENT_CONNECTS + 2);
+    }
+
+    void testTrustedFirst()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        for (int i = 0; i < ConnectScheduler::MAX_CONCURRENT_CONNECTS; i++) {
+            QVERIFY(scheduler.schedule(QStringLiteral("device"), address(i), false, attempts.start(QStringLiteral("running"))));
+        }
+        QVERIFY(scheduler.schedule(QStringLiteral("unknown"), address(1), false, attempts.start(QStringLiteral("unknown"))));
+        QVERIFY(scheduler.schedule(QStringLiteral("trusted"), address(1), true, attempts.start(QStringLiteral("trusted"))));
+
+        Q_EMIT attempts.sockets[0]->encrypted();
+        QCOMPARE(attempts.started.last(), QStringLiteral("trusted"));
+        Q_EMIT attempts.sockets[1]->encrypted();
+        QCOMPARE(attempts.started.last(), QStringLiteral("unknown"));
+    }
+
+    void testQueueLimit()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        for (int i = 0; i < ConnectScheduler::MAX_CONCURRENT_CONNECTS + ConnectScheduler::MAX_QUEUED_CONNECTS; i++) {
+            QVERIFY(scheduler.schedule(QString::number(i), address(1), false, attempts.start(QString::number(i))));
+        }
+        QVERIFY(!scheduler.schedule(QStringLiteral("unknown"), address(1), false, attempts.start(QStringLiteral("unknown"))));
+        // Trusted devices push out an unknown one
+        QVERIFY(scheduler.schedule(QStringLiteral("trusted"), address(1), true, attempts.start(QStringLiteral("trusted"))));
+    }
+
+    void testOneAttemptPerPeer()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("first"))));
+        QVERIFY(!scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("second"))));
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(2), false, attempts.start(QStringLiteral("other address"))));
+
+        Q_EMIT attempts.sockets[0]->encrypted();
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("again"))));
+    }
+
+    void testBackoff()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("first"))));
+        Q_EMIT attempts.sockets.last()->errorOccurred(QAbstractSocket::ConnectionRefusedError);
+        QVERIFY(!scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("too early"))));
+        // The address is part of the peer, another one isn't held back
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(2), false, attempts.start(QStringLiteral("other address"))));
+
+        // 1 s ±25% after the first failure
+        QTest::qWait(500);
+        QVERIFY(!scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("too early"))));
+        QTRY_VERIFY_WITH_TIMEOUT(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("second"))), 1000);
+
+        // 2 s ±25% after the second
+        Q_EMIT attempts.sockets.last()->errorOccurred(QAbstractSocket::ConnectionRefusedError);
+        QTest::qWait(1200);
+        QVERIFY(!scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("too early"))));
+        QTRY_VERIFY_WITH_TIMEOUT(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("third"))), 1500);
+
+        // Success starts over
+        Q_EMIT attempts.sockets.last()->encrypted();
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("fourth"))));
+        Q_EMIT attempts.sockets.last()->errorOccurred(QAbstractSocket::ConnectionRefusedError);
+        QTRY_VERIFY_WITH_TIMEOUT(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("fifth"))), 1500);
+
+        QVERIFY(!attempts.started.contains(QStringLiteral("too early")));
+    }
+
+    void testCancel()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        for (int i = 0; i <= ConnectScheduler::MAX_CONCURRENT_CONNECTS; i++) {
+            QVERIFY(scheduler.schedule(QStringLiteral("device"), address(i), false, attempts.start(QString::number(i))));
+        }
+
+        QSslSocket *cancelled = attempts.sockets[0];
+        scheduler.cancel(cancelled);
+        QCOMPARE(attempts.started.size(), ConnectScheduler::MAX_CONCURRENT_CONNECTS + 1);
+        // Neither the end of the socket nor the cancel count as a failure
+        delete cancelled;
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(0), false, attempts.start(QStringLiteral("again"))));
+    }
+
+    void testDeadline()
+    {
+        ConnectScheduler scheduler;
+        Attempts attempts;
+        QVERIFY(scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("stalled"))));
+        const QPointer<QSslSocket> stalled = attempts.sockets.last();
+
+        QTRY_VERIFY_WITH_TIMEOUT(!stalled, ConnectScheduler::MILLIS_ATTEMPT_DEADLINE + 1000);
+        QVERIFY(!scheduler.schedule(QStringLiteral("device"), address(1), false, attempts.start(QStringLiteral("too early"))));
+    }
+};
+
+QTEST_GUILESS_MAIN(ConnectSchedulerTest)
+
+#include "connectschedulertest.moc"
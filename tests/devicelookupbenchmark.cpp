@@ -0,0 +1,67 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QStandardPaths>
+#include <QTest>
+#include <QUuid>
+
+#include "core/daemon.h"
+#include "core/device.h"
+#include "testdaemon.h"
+
+/**
+ * Daemon::getDevice with 1000 remembered devices, as called for every progress update of a file transfer
+ */
+class DeviceLookupBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    DeviceLookupBenchmark()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        m_daemon = new TestDaemon;
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        for (int i = 0; i < DEVICE_COUNT; i++) {
+            const QString id = QUuid::createUuid().toString(QUuid::WithoutBraces).replace(QLatin1Char('-'), QLatin1Char('_'));
+            m_daemon->addDevice(new Device(m_daemon, id));
+            m_deviceIds.append(id);
+        }
+    }
+
+    void benchmarkGetDevice()
+    {
+        QBENCHMARK {
+            for (const QString &id : std::as_const(m_deviceIds)) {
+                QVERIFY(m_daemon->getDevice(id));
+            }
+        }
+    }
+
+    void benchmarkGetUnknownDevice()
+    {
+        const QString unknownId = QUuid::createUuid().toString(QUuid::WithoutBraces).replace(QLatin1Char('-'), QLatin1Char('_'));
+        QBENCHMARK {
+            for (int i = 0; i < DEVICE_COUNT; i++) {
+                QVERIFY(!m_daemon->getDevice(unknownId));
+            }
+        }
+    }
+
+private:
+    constexpr static int DEVICE_COUNT = 1000;
+
+    TestDaemon *m_daemon;
+    QStringList m_deviceIds;
+};
+
+QTEST_GUILESS_MAIN(DeviceLookupBenchmark)
+
+#include "devicelookupbenchmark.moc"
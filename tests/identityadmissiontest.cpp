@@ -0,0 +1,110 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QTest>
+
+#include "core/backends/lan/identityadmission.h"
+
+static QByteArray identity(const QByteArray &deviceId, int tcpPort = 1716)
+{
+    return "{\"id\":0,\"type\":\"kdeconnect.identity\",\"body\":{\"deviceId\":\"" + deviceId + "\",\"tcpPort\":" + QByteArray::number(tcpPort) + "}}\n";
+}
+
+class IdentityAdmissionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testPeekDeviceId_data()
+    {
+        QTest::addColumn<QByteArray>("datagram");
+        QTest::addColumn<QByteArray>("deviceId");
+
+        QTest::newRow("plain") << identity("abc_123") << QByteArray("abc_123");
+        QTest::newRow("whitespace") << QByteArray("{\"body\": {\"deviceId\" \t:\r\n \"abc_123\" }}") << QByteArray("abc_123");
+        QTest::newRow("escaped") << QByteArray("{\"body\":{\"deviceId\":\"abc\\u005f123\"}}") << QByteArray();
+        QTest::newRow("escaped quote") << QByteArray("{\"body\":{\"deviceId\":\"abc\\\"123\"}}") << QByteArray();
+        QTest::newRow("missing key") << QByteArray("{\"body\":{\"deviceName\":\"abc_123\"}}") << QByteArray();
+        QTest::newRow("missing colon") << QByteArray("{\"body\":{\"deviceId\" \"abc_123\"}}") << QByteArray();
+        QTest::newRow("not a string") << QByteArray("{\"body\":{\"deviceId\":123}}") << QByteArray();
+        QTest::newRow("unterminated") << QByteArray("{\"body\":{\"deviceId\":\"abc_123") << QByteArray();
+        QTest::newRow("empty") << identity("") << QByteArray();
+        const QByteArray longest(IdentityAdmission::MAX_DEVICE_ID_LENGTH, 'a');
+        QTest::newRow("longest") << identity(longest) << longest;
+        QTest::newRow("too long") << identity(longest + 'a') << QByteArray();
+    }
+
+    void testPeekDeviceId()
+    {
+        QFETCH(QByteArray, datagram);
+        QFETCH(QByteArray, deviceId);
+
+        QCOMPARE(IdentityAdmission::peekDeviceId(datagram), deviceId);
+    }
+
+    void testDuplicates()
+    {
+        IdentityAdmission admission;
+        QVERIFY(admission.admit("device", identity("device")));
+        // Copies of the datagram don't take a token, another one still gets through
+        QVERIFY(!admission.admit("device", identity("device")));
+        QVERIFY(!admission.admit("device", identity("device")));
+        QVERIFY(admission.admit("device", identity("device", 1717)));
+
+        // Only other devices are kept apart
+        QVERIFY(admission.admit("other", identity("device")));
+    }
+
+    void testDuplicateWindow()
+    {
+        IdentityAdmission admission;
+        QVERIFY(admission.admit("device", identity("device")));
+        QTest::qWait(IdentityAdmission::MILLIS_DUPLICATE_WINDOW / 2);
+        QVERIFY(!admission.admit("device", identity("device")));
+        // A retry after that is a retry
+        QTest::qWait(IdentityAdmission::MILLIS_DUPLICATE_WINDOW / 2 + 100);
+        QVERIFY(admission.admit("device", identity("device")));
+    }
+
+    void testRefill()
+    {
+        IdentityAdmission admission;
+        int port = 1716;
+        for (int i = 0; i < IdentityAdmission::BUCKET_CAPACITY; i++) {
+            QVERIFY(admission.admit("device", identity("device", port++)));
+        }
+        QVERIFY(!admission.admit("device", identity("device", port++)));
+
+        QTest::qWait(IdentityAdmission::MILLIS_PER_TOKEN / 2);
+        QVERIFY(!admission.admit("device", identity("device", port++)));
+        QTRY_VERIFY_WITH_TIMEOUT(admission.admit("device", identity("device", port++)), IdentityAdmission::MILLIS_PER_TOKEN);
+        // One token per second, no more
+        QVERIFY(!admission.admit("device", identity("device", port++)));
+    }
+
+    void testPrune()
+    {
+        IdentityAdmission admission;
+        for (int i = 0; i < IdentityAdmission::MAX_BUCKETS; i++) {
+            const QByteArray deviceId = "device" + QByteArray::number(i);
+            QVERIFY(admission.admit(deviceId, identity(deviceId)));
+        }
+        QVERIFY(!admission.admit("new", identity("new")));
+        // Known devices keep their buckets
+        QVERIFY(admission.admit("device0", identity("device0", 1717)));
+
+        // Once the buckets are full again they can go, apart from the one that is still empty
+        QTest::qWait(IdentityAdmission::MILLIS_PER_TOKEN + 100);
+        QVERIFY(admission.admit("new", identity("new")));
+        // A fresh bucket would let both through
+        QVERIFY(admission.admit("device0", identity("device0", 1718)));
+        QVERIFY(!admission.admit("device0", identity("device0", 1719)));
+    }
+};
+
+QTEST_GUILESS_MAIN(IdentityAdmissionTest)
+
+#include "identityadmissiontest.moc"
@@ -0,0 +1,163 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+#include <QtEndian>
+
+#include "core/backends/lan/lanstripedpayload.h"
+
+static QByteArray stripeHeader(qint64 offset, qint64 length)
+{
+    QByteArray header(LanStripedPayload::STRIPE_HEADER_SIZE, '\0');
+    qToBigEndian<qint64>(offset, header.data());
+    qToBigEndian<qint64>(length, header.data() + 8);
+    return header;
+}
+
+/**
+ * Feeds a LanStripedPayload over plain TCP connections to ourselves, the stripes don't care about TLS
+ */
+class LanStripedPayloadTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        QVERIFY(m_server.listen(QHostAddress::LocalHost));
+        for (int i = 0; i < STRIPES; i++) {
+            QSslSocket *receiver = new QSslSocket;
+            receiver->connectToHost(QHostAddress::LocalHost, m_server.serverPort());
+            QVERIFY(m_server.waitForNewConnection(1000));
+            QVERIFY(receiver->waitForConnected(1000));
+            m_receivers.append(receiver);
+            m_senders.append(m_server.nextPendingConnection());
+        }
+        m_payload = new LanStripedPayload(m_receivers, SIZE);
+    }
+
+    void cleanup()
+    {
+        delete m_payload;
+        qDeleteAll(m_senders);
+        m_receivers.clear();
+        m_senders.clear();
+        m_server.close();
+    }
+
+    void testRanges()
+    {
+        const QByteArray data = payloadData();
+        // In another order than the connections, and the first range split across two writes
+        sendStripe(0, SIZE * 2 / 3, SIZE);
+        sendStripe(1, 0, SIZE / 3);
+        m_senders[2]->write(stripeHeader(SIZE / 3, SIZE * 2 / 3 - SIZE / 3) + data.mid(SIZE / 3, 10));
+        m_senders[2]->write(data.mid(SIZE / 3 + 10, SIZE * 2 / 3 - SIZE / 3 - 10));
+
+        QSignalSpy finished(m_payload, &QIODevice::readChannelFinished);
+        QCOMPARE(readAll(), data);
+        QVERIFY(finished.count() || finished.wait());
+        for (QSslSocket *receiver : std::as_const(m_receivers)) {
+            QCOMPARE(receiver->state(), QAbstractSocket::ConnectedState);
+        }
+    }
+
+    void testInvalidRanges_data()
+    {
+        QTest::addColumn<qint64>("offset");
+        QTest::addColumn<qint64>("length");
+
+        QTest::newRow("same range twice") << qint64(0) << qint64(SIZE / 3);
+        QTest::newRow("overlapping") << qint64(SIZE / 3 - 1) << qint64(SIZE / 3);
+        QTest::newRow("shorter") << qint64(SIZE / 3) << qint64(SIZE / 3 - 1);
+        QTest::newRow("past the end") << qint64(SIZE * 2 / 3) << qint64(SIZE);
+        QTest::newRow("negative") << qint64(-1) << qint64(SIZE / 3);
+    }
+
+    void testInvalidRanges()
+    {
+        QFETCH(qint64, offset);
+        QFETCH(qint64, length);
+
+        // Adds up to the whole payload, but the last range isn't one of those it was split into
+        sendStripe(0, 0, SIZE / 3);
+        sendStripe(1, SIZE * 2 / 3, SIZE);
+        m_senders[2]->write(stripeHeader(offset, length) + QByteArray(qBound<qint64>(0, length, SIZE), 'x'));
+
+        QSignalSpy finished(m_payload, &QIODevice::readChannelFinished);
+        readAll();
+        QVERIFY(finished.count() || finished.wait());
+        for (QSslSocket *receiver : std::as_const(m_receivers)) {
+            QCOMPARE(receiver->state(), QAbstractSocket::UnconnectedState);
+        }
+    }
+
+    void testClosedEarly()
+    {
+        sendStripe(0, 0, SIZE / 3);
+        sendStripe(1, SIZE * 2 / 3, SIZE);
+        m_senders[2]->write(stripeHeader(SIZE / 3, SIZE * 2 / 3 - SIZE / 3) + payloadData().mid(SIZE / 3, 10));
+        m_senders[2]->disconnectFromHost();
+
+        QSignalSpy finished(m_payload, &QIODevice::readChannelFinished);
+        QVERIFY(readAll().size() < SIZE);
+        QVERIFY(finished.count() || finished.wait());
+        QCOMPARE(m_receivers[0]->state(), QAbstractSocket::UnconnectedState);
+    }
+
+private:
+    constexpr static int STRIPES = 3;
+    constexpr static qint64 SIZE = 100000;
+
+    static QByteArray payloadData()
+    {
+        QByteArray data;
+        for (qint64 i = 0; i < SIZE; i++) {
+            data.append(char(i % 251));
+        }
+        return data;
+    }
+
+    void sendStripe(int connection, qint64 offset, qint64 end)
+    {
+        m_senders[connection]->write(stripeHeader(offset, end - offset) + payloadData().mid(offset, end - offset));
+    }
+
+    // Puts every range where it belongs, until the payload ends or nothing arrives for a while
+    QByteArray readAll()
+    {
+        QByteArray data(SIZE, '\0');
+        qint64 total = 0;
+        char buffer[4096];
+        QElapsedTimer idle;
+        idle.start();
+        while (!m_payload->atEnd() && idle.elapsed() < 1000) {
+            qint64 offset;
+            const qint64 bytesRead = m_payload->readAnyRange(buffer, sizeof(buffer), &offset);
+            if (bytesRead > 0) {
+                memcpy(data.data() + offset, buffer, bytesRead);
+                total += bytesRead;
+                idle.restart();
+            } else {
+                QTest::qWait(10);
+            }
+        }
+        return total == SIZE ? data : data.left(total);
+    }
+
+    QTcpServer m_server;
+    QList<QSslSocket *> m_receivers;
+    QList<QTcpSocket *> m_senders;
+    LanStripedPayload *m_payload = nullptr;
+};
+
+QTEST_GUILESS_MAIN(LanStripedPayloadTest)
+
+#include "lanstripedpayloadtest.moc"
@@ -0,0 +1,147 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QEventLoop>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTest>
+#include <QTimer>
+#include <QUuid>
+
+#include "core/backends/multiplexer/connectionmultiplexer.h"
+#include "core/backends/multiplexer/multiplexchannel.h"
+
+/**
+ * Forwards everything written on one socket to the other after a fixed delay, in both directions
+ */
+class DelayedRelay : public QObject
+{
+public:
+    DelayedRelay(QLocalSocket *first, QLocalSocket *second, int delay)
+    {
+        forward(first, second, delay);
+        forward(second, first, delay);
+    }
+
+private:
+    void forward(QLocalSocket *from, QLocalSocket *to, int delay)
+    {
+        connect(from, &QIODevice::readyRead, this, [this, from, to, delay]() {
+            const QByteArray data = from->readAll();
+            QTimer::singleShot(delay, Qt::PreciseTimer, this, [to, data]() {
+                to->write(data);
+            });
+        });
+    }
+};
+
+/**
+ * Throughput of a single multiplexed channel over a local socket pair, starting from the 4 KiB bluetooth window.
+ *
+ * Protocol version 1 needs a read request round trip for every 4 KiB. Version 2 grows the window with the measured
+ * bandwidth-delay product, which shows most in the rows where the relay adds a round trip time.
+ */
+class MultiplexerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkTransfer_data()
+    {
+        QTest::addColumn<int>("protocolVersion");
+        QTest::addColumn<int>("delay");
+        QTest::newRow("v1 0ms") << 1 << 0;
+        QTest::newRow("v2 0ms") << 2 << 0;
+        QTest::newRow("v1 5ms") << 1 << 5;
+        QTest::newRow("v2 5ms") << 2 << 5;
+    }
+
+    void benchmarkTransfer()
+    {
+        QFETCH(int, protocolVersion);
+        QFETCH(int, delay);
+
+        QLocalServer server;
+        server.setSocketOptions(QLocalServer::UserAccessOption);
+        QVERIFY(server.listen(QStringLiteral("kdeconnect-multiplexerbenchmark-") + QUuid::createUuid().toString(QUuid::WithoutBraces)));
+
+        QLocalSocket *senderSocket;
+        QLocalSocket *receiverSocket;
+        QVERIFY(connectedPair(&server, &senderSocket, &receiverSocket));
+
+        // With a delay, the sender's pair ends in the relay, which passes everything on to a second pair
+        std::unique_ptr<DelayedRelay> relay;
+        if (delay > 0) {
+            QLocalSocket *relayIn = receiverSocket;
+            QLocalSocket *relayOut;
+            QVERIFY(connectedPair(&server, &relayOut, &receiverSocket));
+            relay.reset(new DelayedRelay(relayIn, relayOut, delay));
+        }
+
+        ConnectionMultiplexer sender(senderSocket, nullptr, ConnectionMultiplexer::DEFAULT_CHANNEL_BUFFER_SIZE, protocolVersion);
+        ConnectionMultiplexer receiver(receiverSocket, nullptr, ConnectionMultiplexer::DEFAULT_CHANNEL_BUFFER_SIZE, protocolVersion);
+
+        const QByteArray payload(PAYLOAD_SIZE, 'x');
+        QBENCHMARK {
+            const QUuid channelId = sender.newChannel();
+            std::unique_ptr<MultiplexChannel> out = sender.getChannel(channelId);
+            out->write(payload);
+            QCOMPARE(transfer(&receiver, channelId), PAYLOAD_SIZE);
+        }
+
+        QCOMPARE(sender.negotiatedProtocolVersion(), protocolVersion);
+        QCOMPARE(receiver.negotiatedProtocolVersion(), protocolVersion);
+    }
+
+private:
+    /**
+     * Connect a new socket to @p server, both ends are owned by the server
+     */
+    bool connectedPair(QLocalServer *server, QLocalSocket **client, QLocalSocket **accepted)
+    {
+        *client = new QLocalSocket(server);
+        (*client)->connectToServer(server->fullServerName());
+        if (!(*client)->waitForConnected(5000) || !server->waitForNewConnection(5000)) {
+            return false;
+        }
+        *accepted = server->nextPendingConnection();
+        return *accepted != nullptr;
+    }
+
+    qint64 transfer(ConnectionMultiplexer *receiver, const QUuid &channelId)
+    {
+        QEventLoop loop;
+        std::unique_ptr<MultiplexChannel> in;
+        qint64 received = 0;
+        auto readSome = [&]() {
+            received += in->readAll().size();
+            if (received >= PAYLOAD_SIZE) {
+                loop.quit();
+            }
+        };
+
+        // The channel exists once its open message arrived
+        QTimer poll;
+        connect(&poll, &QTimer::timeout, &loop, [&]() {
+            in = receiver->getChannel(channelId);
+            if (in) {
+                poll.stop();
+                connect(in.get(), &QIODevice::readyRead, &loop, readSome);
+                readSome();
+            }
+        });
+        poll.start(0);
+        QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+        loop.exec();
+        return received;
+    }
+
+    constexpr static qint64 PAYLOAD_SIZE = 1024 * 1024;
+};
+
+QTEST_GUILESS_MAIN(MultiplexerBenchmark)
+
+#include "multiplexerbenchmark.moc"
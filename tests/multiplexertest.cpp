@@ -0,0 +1,269 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTest>
+#include <QUuid>
+#include <QtEndian>
+
+#include "core/backends/multiplexer/connectionmultiplexer.h"
+#include "core/backends/multiplexer/multiplexchannel.h"
+
+// The default channel every connection starts with
+static const QUuid DEFAULT_CHANNEL_ID(QStringLiteral("a0d0aaf4-1072-4d81-aa35-902a954b1266"));
+
+/**
+ * A protocol version 1 message, as the other endpoint would send it
+ */
+static QByteArray message(char type, const QUuid &channelId, const QByteArray &data = QByteArray())
+{
+    QByteArray message(3, type);
+    qToBigEndian<quint16>(data.size(), message.data() + 1);
+    return message + channelId.toRfc4122() + data;
+}
+
+static QByteArray versionMessage(quint16 lowest, quint16 highest)
+{
+    QByteArray versions(4, '\0');
+    qToBigEndian<quint16>(lowest, versions.data());
+    qToBigEndian<quint16>(highest, versions.data() + 2);
+    return message(0, QUuid(), versions);
+}
+
+/**
+ * Counts what arrives on a channel, and what had arrived on another one by the time this one got everything
+ */
+class ChannelReader : public QObject
+{
+public:
+    ChannelReader(std::unique_ptr<MultiplexChannel> channel, qint64 expected, const ChannelReader *other = nullptr)
+        : m_channel(std::move(channel))
+        , m_expected(expected)
+        , m_other(other)
+    {
+        connect(m_channel.get(), &QIODevice::readyRead, this, &ChannelReader::readSome);
+        readSome();
+    }
+
+    bool isComplete() const
+    {
+        return received == m_expected;
+    }
+
+    qint64 received = 0;
+    qint64 otherReceivedAtCompletion = -1;
+
+private:
+    void readSome()
+    {
+        const qint64 bytesRead = m_channel->readAll().size();
+        if (bytesRead <= 0) {
+            return;
+        }
+        received += bytesRead;
+        if (isComplete() && m_other) {
+            otherReceivedAtCompletion = m_other->received;
+        }
+    }
+
+    std::unique_ptr<MultiplexChannel> m_channel;
+    const qint64 m_expected;
+    const ChannelReader *m_other;
+};
+
+/**
+ * The scheduling of channels that all have data to send, over a local socket pair
+ */
+class MultiplexerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        m_server.setSocketOptions(QLocalServer::UserAccessOption);
+        QVERIFY(m_server.listen(QStringLiteral("kdeconnect-multiplexertest-") + QUuid::createUuid().toString(QUuid::WithoutBraces)));
+
+        QLocalSocket *senderSocket = new QLocalSocket(&m_server);
+        senderSocket->connectToServer(m_server.fullServerName());
+        QVERIFY(senderSocket->waitForConnected(5000));
+        QVERIFY(m_server.waitForNewConnection(5000));
+        QLocalSocket *receiverSocket = m_server.nextPendingConnection();
+        QVERIFY(receiverSocket);
+
+        m_sender.reset(new ConnectionMultiplexer(senderSocket, nullptr, WINDOW_SIZE));
+        m_receiver.reset(new ConnectionMultiplexer(receiverSocket, nullptr, WINDOW_SIZE));
+    }
+
+    void cleanup()
+    {
+        m_sender.reset();
+        m_receiver.reset();
+        m_rawMultiplexer.reset();
+        m_server.close();
+    }
+
+    void testControlOvertakesBulk()
+    {
+        const QUuid bulkId = m_sender->newChannel();
+        std::unique_ptr<MultiplexChannel> bulk = m_sender->getChannel(bulkId);
+        std::unique_ptr<MultiplexChannel> control = m_sender->getDefaultChannel();
+        std::unique_ptr<MultiplexChannel> bulkIn = receivedChannel(bulkId);
+        QVERIFY(bulkIn);
+        ChannelReader bulkReader(std::move(bulkIn), BULK_SIZE);
+        ChannelReader controlReader(m_receiver->getDefaultChannel(), 7, &bulkReader);
+
+        // The packet only comes after a whole transfer was queued, but it doesn't wait for it
+        bulk->write(QByteArray(BULK_SIZE, 'x'));
+        control->write(QByteArrayLiteral("packet\n"));
+
+        QTRY_VERIFY(controlReader.isComplete());
+        QVERIFY(controlReader.otherReceivedAtCompletion < BULK_SIZE / 2);
+        QTRY_VERIFY(bulkReader.isComplete());
+    }
+
+    void testInteractiveOvertakesBulk()
+    {
+        const QUuid bulkId = m_sender->newChannel();
+        const QUuid iconId = m_sender->newChannel();
+        m_sender->setChannelPriority(iconId, ConnectionMultiplexer::InteractivePriority);
+        std::unique_ptr<MultiplexChannel> bulk = m_sender->getChannel(bulkId);
+        std::unique_ptr<MultiplexChannel> icon = m_sender->getChannel(iconId);
+        std::unique_ptr<MultiplexChannel> bulkIn = receivedChannel(bulkId);
+        std::unique_ptr<MultiplexChannel> iconIn = receivedChannel(iconId);
+        QVERIFY(bulkIn && iconIn);
+        ChannelReader bulkReader(std::move(bulkIn), BULK_SIZE);
+        ChannelReader iconReader(std::move(iconIn), ICON_SIZE, &bulkReader);
+
+        bulk->write(QByteArray(BULK_SIZE, 'x'));
+        icon->write(QByteArray(ICON_SIZE, 'i'));
+
+        QTRY_VERIFY(iconReader.isComplete());
+        QVERIFY(iconReader.otherReceivedAtCompletion < BULK_SIZE / 2);
+        QTRY_VERIFY(bulkReader.isComplete());
+    }
+
+    void testBulkChannelsInterleave()
+    {
+        const QUuid firstId = m_sender->newChannel();
+        const QUuid secondId = m_sender->newChannel();
+        std::unique_ptr<MultiplexChannel> first = m_sender->getChannel(firstId);
+        std::unique_ptr<MultiplexChannel> second = m_sender->getChannel(secondId);
+        std::unique_ptr<MultiplexChannel> firstIn = receivedChannel(firstId);
+        std::unique_ptr<MultiplexChannel> secondIn = receivedChannel(secondId);
+        QVERIFY(firstIn && secondIn);
+        ChannelReader secondReader(std::move(secondIn), BULK_SIZE);
+        ChannelReader firstReader(std::move(firstIn), BULK_SIZE, &secondReader);
+
+        // The first one has all of its data queued before the second one starts
+        first->write(QByteArray(BULK_SIZE, 'a'));
+        second->write(QByteArray(BULK_SIZE, 'b'));
+
+        QTRY_VERIFY(firstReader.isComplete() && secondReader.isComplete());
+        // They took turns, instead of the second one waiting for the first
+        QVERIFY(firstReader.otherReceivedAtCompletion >= BULK_SIZE / 2);
+    }
+
+    void testProtocolErrors_data()
+    {
+        QTest::addColumn<QByteArray>("messages");
+
+        const QByteArray version = versionMessage(1, 1);
+        QTest::newRow("no version") << message(1, QUuid::createUuid());
+        QTest::newRow("unsupported version") << versionMessage(2, 3);
+        QTest::newRow("version twice") << version + version;
+        QTest::newRow("unknown type") << version + message(7, DEFAULT_CHANNEL_ID);
+        QTest::newRow("open with data") << version + message(1, QUuid::createUuid(), "x");
+        QTest::newRow("open twice") << version + message(1, DEFAULT_CHANNEL_ID);
+        QTest::newRow("empty read") << version + message(3, DEFAULT_CHANNEL_ID, QByteArray(2, '\0'));
+        QTest::newRow("empty write") << version + message(4, DEFAULT_CHANNEL_ID);
+        // The default channel asked for WINDOW_SIZE bytes
+        QTest::newRow("write past the window") << version + message(4, DEFAULT_CHANNEL_ID, QByteArray(0xFFFF, 'x'))
+                + message(4, DEFAULT_CHANNEL_ID, QByteArray(WINDOW_SIZE - 0xFFFF + 1, 'x'));
+    }
+
+    void testProtocolErrors()
+    {
+        QFETCH(QByteArray, messages);
+
+        QLocalSocket *peer = connectRawPeer();
+        QVERIFY(peer);
+        // Wait for the read requests, so the windows are known
+        QTRY_VERIFY(peer->bytesAvailable() > 23);
+        peer->write(messages);
+
+        QTRY_VERIFY(!m_rawMultiplexer->isOpen());
+    }
+
+    void testUnrequestedChannelsCapped()
+    {
+        QLocalSocket *peer = connectRawPeer();
+        QVERIFY(peer);
+        // Taken right away, like a device link does
+        std::unique_ptr<MultiplexChannel> control = m_rawMultiplexer->getDefaultChannel();
+        peer->write(versionMessage(1, 1));
+
+        QList<QUuid> channelIds;
+        for (int i = 0; i <= MAX_UNREQUESTED_CHANNELS; i++) {
+            channelIds.append(QUuid::createUuid());
+            peer->write(message(1, channelIds.last()));
+        }
+
+        // Only the one past the limit is closed right away
+        QByteArray received;
+        const QByteArray refused = message(2, channelIds.last());
+        QTRY_VERIFY((received += peer->readAll()).contains(refused));
+        QVERIFY(!received.contains(message(2, channelIds.first())));
+        QVERIFY(m_rawMultiplexer->isOpen());
+        QVERIFY(m_rawMultiplexer->getChannel(channelIds.first()));
+        QVERIFY(!m_rawMultiplexer->getChannel(channelIds.last()));
+    }
+
+private:
+    /**
+     * A multiplexer whose other endpoint is a plain socket, for the test to send whatever it likes
+     */
+    QLocalSocket *connectRawPeer()
+    {
+        QLocalSocket *peer = new QLocalSocket(&m_server);
+        peer->connectToServer(m_server.fullServerName());
+        if (!peer->waitForConnected(5000) || !m_server.waitForNewConnection(5000)) {
+            return nullptr;
+        }
+        m_rawMultiplexer.reset(new ConnectionMultiplexer(m_server.nextPendingConnection(), nullptr, WINDOW_SIZE));
+        return peer;
+    }
+
+    std::unique_ptr<MultiplexChannel> receivedChannel(const QUuid &channelId)
+    {
+        // The channel exists once its open message arrived
+        std::unique_ptr<MultiplexChannel> channel;
+        QElapsedTimer timer;
+        timer.start();
+        while (!(channel = m_receiver->getChannel(channelId)) && timer.elapsed() < 5000) {
+            QTest::qWait(10);
+        }
+        return channel;
+    }
+
+    // Small windows, so the scheduler gets to decide often
+    constexpr static int WINDOW_SIZE = 64 * 1024;
+    constexpr static qint64 BULK_SIZE = 8 * 1024 * 1024;
+    constexpr static qint64 ICON_SIZE = 32 * 1024;
+    // As in ConnectionMultiplexer
+    constexpr static int MAX_UNREQUESTED_CHANNELS = 20;
+
+    QLocalServer m_server;
+    std::unique_ptr<ConnectionMultiplexer> m_sender;
+    std::unique_ptr<ConnectionMultiplexer> m_receiver;
+    std::unique_ptr<ConnectionMultiplexer> m_rawMultiplexer;
+};
+
+QTEST_GUILESS_MAIN(MultiplexerTest)
+
+#include "multiplexertest.moc"
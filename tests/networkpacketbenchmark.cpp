@@ -0,0 +1,135 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QTest>
+
+#include "core/networkpacket.h"
+
+class NetworkPacketBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRoundTrip_data()
+    {
+        QTest::addColumn<bool>("cbor");
+        QTest::newRow("json") << false;
+        QTest::newRow("cbor") << true;
+    }
+
+    void testRoundTrip()
+    {
+        QFETCH(bool, cbor);
+        NetworkPacket np = mousepadPacket();
+        np.setPayload(QSharedPointer<QIODevice>(), 1234);
+        np.setPayloadTransferInfo({{QStringLiteral("port"), 1739}});
+
+        NetworkPacket decoded;
+        QVERIFY(cbor ? NetworkPacket::unserializeCbor(np.serializeCbor(), &decoded) : NetworkPacket::unserialize(np.serialize(), &decoded));
+        QCOMPARE(decoded.id(), np.id());
+        QCOMPARE(decoded.type(), np.type());
+        QCOMPARE(decoded.get<int>(QStringLiteral("dx")), 12);
+        QCOMPARE(decoded.get<double>(QStringLiteral("dy")), -3.5);
+        QCOMPARE(decoded.get<bool>(QStringLiteral("singleclick")), true);
+        QCOMPARE(decoded.payloadSize(), qint64(1234));
+        QCOMPARE(decoded.payloadTransferInfo().value(QStringLiteral("port")).toInt(), 1739);
+    }
+
+    void testNumericId()
+    {
+        NetworkPacket decoded;
+        QVERIFY(NetworkPacket::unserialize(R"({"id":1767268800000,"type":"kdeconnect.ping","body":{}})", &decoded));
+        QCOMPARE(decoded.id(), QStringLiteral("1767268800000"));
+        QCOMPARE(decoded.type(), QStringLiteral("kdeconnect.ping"));
+        QVERIFY(!decoded.hasPayload());
+    }
+
+    // Each iteration handles a single packet, so packets per second are the inverse of the reported time
+    void benchmarkEncode_data()
+    {
+        QTest::addColumn<NetworkPacket>("packet");
+        QTest::addColumn<bool>("cbor");
+
+        const QList<std::pair<const char *, NetworkPacket>> shapes = packetShapes();
+        for (const auto &[name, packet] : shapes) {
+            QTest::addRow("%s json", name) << packet << false;
+            QTest::addRow("%s cbor", name) << packet << true;
+        }
+    }
+
+    void benchmarkEncode()
+    {
+        QFETCH(NetworkPacket, packet);
+        QFETCH(bool, cbor);
+        QBENCHMARK {
+            const QByteArray data = cbor ? packet.serializeCbor() : packet.serialize();
+            Q_UNUSED(data);
+        }
+    }
+
+    void benchmarkDecode_data()
+    {
+        benchmarkEncode_data();
+    }
+
+    void benchmarkDecode()
+    {
+        QFETCH(NetworkPacket, packet);
+        QFETCH(bool, cbor);
+        const QByteArray data = cbor ? packet.serializeCbor() : packet.serialize();
+        QBENCHMARK {
+            NetworkPacket decoded;
+            if (cbor) {
+                NetworkPacket::unserializeCbor(data, &decoded);
+            } else {
+                NetworkPacket::unserialize(data, &decoded);
+            }
+        }
+    }
+
+private:
+    static NetworkPacket mousepadPacket()
+    {
+        return NetworkPacket(QStringLiteral("kdeconnect.mousepad.request"),
+                             {{QStringLiteral("dx"), 12}, {QStringLiteral("dy"), -3.5}, {QStringLiteral("singleclick"), true}});
+    }
+
+    static QList<std::pair<const char *, NetworkPacket>> packetShapes()
+    {
+        const NetworkPacket battery(QStringLiteral("kdeconnect.battery"),
+                                    {{QStringLiteral("currentCharge"), 84}, {QStringLiteral("isCharging"), false}, {QStringLiteral("thresholdEvent"), 0}});
+
+        const NetworkPacket mpris(QStringLiteral("kdeconnect.mpris"),
+                                  {{QStringLiteral("player"), QStringLiteral("VLC media player")},
+                                   {QStringLiteral("title"), QStringLiteral("Some Song")},
+                                   {QStringLiteral("artist"), QStringLiteral("Some Artist")},
+                                   {QStringLiteral("album"), QStringLiteral("Some Album")},
+                                   {QStringLiteral("isPlaying"), true},
+                                   {QStringLiteral("pos"), 93512},
+                                   {QStringLiteral("length"), 241000},
+                                   {QStringLiteral("volume"), 70},
+                                   {QStringLiteral("canPause"), true},
+                                   {QStringLiteral("canPlay"), true},
+                                   {QStringLiteral("canGoNext"), true},
+                                   {QStringLiteral("canGoPrevious"), true},
+                                   {QStringLiteral("canSeek"), true}});
+
+        NetworkPacket share(QStringLiteral("kdeconnect.share.request"),
+                            {{QStringLiteral("filename"), QStringLiteral("IMG_20260101_120000.jpg")},
+                             {QStringLiteral("creationTime"), Q_INT64_C(1767268800000)},
+                             {QStringLiteral("lastModified"), Q_INT64_C(1767268800000)},
+                             {QStringLiteral("numberOfFiles"), 1},
+                             {QStringLiteral("totalPayloadSize"), 4194304}});
+        share.setPayload(QSharedPointer<QIODevice>(), 4194304);
+        share.setPayloadTransferInfo({{QStringLiteral("port"), 1739}});
+
+        return {{"mousepad", mousepadPacket()}, {"battery", battery}, {"mpris", mpris}, {"share", share}};
+    }
+};
+
+QTEST_GUILESS_MAIN(NetworkPacketBenchmark)
+
+#include "networkpacketbenchmark.moc"
@@ -5,6 +5,7 @@
  */
 
 #include <QCoreApplication>
+#include <QFileInfo>
 #include <QSignalSpy>
 #include <QSocketNotifier>
 #include <QStandardPaths>
@@ -20,6 +21,8 @@
 #include "kdeconnect-version.h"
 #include "testdaemon.h"
 #include <backends/lan/compositeuploadjob.h>
+#include <backends/lan/lanlinkprovider.h>
+#include <backends/lan/lanstripedpayload.h>
 #include <backends/pairinghandler.h>
 #include <plugins/share/shareplugin.h>
 
@@ -78,6 +81,84 @@ private Q_SLOTS:
         QCOMPARE(file.readAll(), content);
     }
 
+    void benchmarkParallelStreams_data()
+    {
+        QTest::addColumn<int>("streams");
+
+        QTest::newRow("1 stream") << 1;
+        QTest::newRow("4 streams") << 4;
+    }
+
+    void benchmarkParallelStreams()
+    {
+        QFETCH(int, streams);
+
+        // The loopback device delivers the packet, the payload itself goes over TLS connections to ourselves
+        const QString deviceId = KdeConnectConfig::instance().deviceId();
+        KdeConnectConfig::instance().addTrustedDevice(KdeConnectConfig::instance().deviceInfo());
+        Device *device = m_daemon->getDevice(deviceId);
+        QVERIFY(device);
+        QVERIFY(device->isReachable());
+        QVERIFY(device->isPaired());
+
+        QTemporaryFile source;
+        QVERIFY(source.open());
+        const QByteArray chunk(1024 * 1024, 'x');
+        for (int i = 0; i < 64; i++) {
+            source.write(chunk);
+        }
+        source.close();
+
+        const QString destFile = QDir::tempPath() + QStringLiteral("/kdeconnect-test-parallel");
+
+        QBENCHMARK {
+            QFile(destFile).remove();
+
+            QSharedPointer<QFile> f(new QFile(source.fileName()));
+            // Not handled by any plugin, so only this test reads the payload
+            NetworkPacket np(QStringLiteral("kdeconnect.test.benchmark"));
+            np.setPayload(f, f->size());
+
+            CompositeUploadJob *job = new CompositeUploadJob(deviceId, false);
+            job->setParallelStreams(streams);
+            job->addSubjob(new UploadJob(np));
+            QSignalSpy spyUpload(job, &KJob::result);
+            job->start();
+
+            QTRY_VERIFY(!job->transferInfo().isEmpty());
+            const QVariantMap transferInfo = job->transferInfo();
+            const quint16 port = transferInfo[QStringLiteral("port")].toInt();
+            const int stripes = transferInfo.value(QStringLiteral("parallelStreams"), 1).toInt();
+            QCOMPARE(stripes, streams);
+
+            QList<QSslSocket *> sockets;
+            for (int i = 0; i < stripes; i++) {
+                QSslSocket *socket = new QSslSocket;
+                LanLinkProvider::configureSslSocket(socket, deviceId, true);
+                connect(socket, &QAbstractSocket::disconnected, socket, &QAbstractSocket::readChannelFinished);
+                socket->connectToHostEncrypted(QStringLiteral("127.0.0.1"), port, QIODevice::ReadWrite);
+                sockets.append(socket);
+            }
+
+            NetworkPacket received(np.type());
+            if (stripes > 1) {
+                received.setPayload(QSharedPointer<QIODevice>(new LanStripedPayload(sockets, np.payloadSize())), np.payloadSize());
+            } else {
+                received.setPayload(QSharedPointer<QIODevice>(sockets.first()), np.payloadSize());
+            }
+
+            FileTransferJob *ft = received.createPayloadTransferJob(QUrl::fromLocalFile(destFile));
+            QSignalSpy spyTransfer(ft, &KJob::result);
+            ft->start();
+
+            QVERIFY(spyTransfer.wait(60000));
+            QCOMPARE(ft->error(), 0);
+            QTRY_COMPARE(spyUpload.count(), 1);
+        }
+
+        QCOMPARE(QFileInfo(destFile).size(), source.size());
+    }
+
     void testSslJobs()
     {
         const QString aFile = QFINDTESTDATA("sendfiletest.cpp");
@@ -0,0 +1,205 @@
+/**
+ * SPDX-FileCopyrightText: 2026 KDE Connect Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only OR LicenseRef-KDE-Accepted-GPL
+ */
+
+#include <QEventLoop>
+#include <QMap>
+#include <QSslConfiguration>
+#include <QSslKey>
+#include <QSslSocket>
+#include <QTcpServer>
+#include <QTest>
+#include <QTimer>
+
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+
+#include "core/sslhelper.h"
+
+/**
+ * A TLS server on a single OpenSSL context, so every connection shares the session ticket keys and can resume the
+ * sessions of earlier ones. QSslSocket can't do that, it creates a context for every socket.
+ *
+ * The sockets stay on the event loop: OpenSSL reads from and writes to memory BIOs that we fill and drain.
+ */
+class OpenSslServer : public QTcpServer
+{
+public:
+    OpenSslServer(const QSslKey &key, const QSslCertificate &certificate)
+        : m_context(SSL_CTX_new(TLS_server_method()))
+        , m_handshakes(0)
+        , m_resumedHandshakes(0)
+    {
+        const QByteArray keyPem = key.toPem();
+        BIO *keyBio = BIO_new_mem_buf(keyPem.constData(), keyPem.size());
+        EVP_PKEY *privateKey = PEM_read_bio_PrivateKey(keyBio, nullptr, nullptr, nullptr);
+        BIO_free(keyBio);
+        const QByteArray certificatePem = certificate.toPem();
+        BIO *certificateBio = BIO_new_mem_buf(certificatePem.constData(), certificatePem.size());
+        X509 *x509 = PEM_read_bio_X509(certificateBio, nullptr, nullptr, nullptr);
+        BIO_free(certificateBio);
+
+        SSL_CTX_use_certificate(m_context, x509);
+        SSL_CTX_use_PrivateKey(m_context, privateKey);
+        X509_free(x509);
+        EVP_PKEY_free(privateKey);
+    }
+
+    ~OpenSslServer() override
+    {
+        // Each socket frees its SSL object, which holds on to the context
+        qDeleteAll(findChildren<QTcpSocket *>());
+        SSL_CTX_free(m_context);
+    }
+
+    int handshakes() const
+    {
+        return m_handshakes;
+    }
+
+    int resumedHandshakes() const
+    {
+        return m_resumedHandshakes;
+    }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        socket->setSocketDescriptor(socketDescriptor);
+
+        SSL *ssl = SSL_new(m_context);
+        BIO *input = BIO_new(BIO_s_mem());
+        BIO *output = BIO_new(BIO_s_mem());
+        SSL_set_bio(ssl, input, output);
+        SSL_set_accept_state(ssl);
+
+        connect(socket, &QIODevice::readyRead, socket, [this, socket, ssl, input, output]() {
+            const QByteArray data = socket->readAll();
+            BIO_write(input, data.constData(), data.size());
+            char buffer[4096];
+            if (!SSL_is_init_finished(ssl)) {
+                if (SSL_do_handshake(ssl) == 1) {
+                    m_handshakes++;
+                    if (SSL_session_reused(ssl)) {
+                        m_resumedHandshakes++;
+                    }
+                }
+            } else {
+                // The client doesn't send anything after the handshake, this only takes care of its alerts
+                SSL_read(ssl, buffer, sizeof(buffer));
+            }
+
+            int bytesRead;
+            while ((bytesRead = BIO_read(output, buffer, sizeof(buffer))) > 0) {
+                socket->write(buffer, bytesRead);
+            }
+        });
+        connect(socket, &QAbstractSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QObject::destroyed, [ssl]() {
+            SSL_free(ssl);
+        });
+    }
+
+private:
+    SSL_CTX *const m_context;
+    int m_handshakes;
+    int m_resumedHandshakes;
+};
+
+/**
+ * Time of a TLS handshake of a QSslSocket client over loopback with RSA and EC identities, with and without offering
+ * a session ticket from a previous connection. The server keeps its ticket keys like the Android app does, the rows
+ * with a ticket check that the handshakes were really resumed.
+ */
+class SslHandshakeBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        for (QSsl::KeyAlgorithm algorithm : {QSsl::Rsa, QSsl::Ec}) {
+            const QSslKey key = SslHelper::generatePrivateKey(algorithm);
+            QVERIFY(!key.isNull());
+            QCOMPARE(SslHelper::readPrivateKey(key.toPem()), key);
+
+            QSslConfiguration configuration;
+            configuration.setLocalCertificate(SslHelper::generateSelfSignedCertificate(key, QStringLiteral("benchmark")));
+            configuration.setPrivateKey(key);
+            configuration.setPeerVerifyMode(QSslSocket::QueryPeer);
+            // Tickets only come with TLS 1.3 from a server that knows it, like ours
+            configuration.setProtocol(QSsl::TlsV1_3OrLater);
+            m_configurations.insert(algorithm, configuration);
+        }
+    }
+
+    void benchmarkHandshake_data()
+    {
+        QTest::addColumn<QSsl::KeyAlgorithm>("algorithm");
+        QTest::addColumn<bool>("resume");
+        QTest::newRow("rsa full") << QSsl::Rsa << false;
+        QTest::newRow("rsa ticket") << QSsl::Rsa << true;
+        QTest::newRow("ec full") << QSsl::Ec << false;
+        QTest::newRow("ec ticket") << QSsl::Ec << true;
+    }
+
+    void benchmarkHandshake()
+    {
+        QFETCH(QSsl::KeyAlgorithm, algorithm);
+        QFETCH(bool, resume);
+        m_configuration = m_configurations.value(algorithm);
+
+        OpenSslServer server(m_configuration.privateKey(), m_configuration.localCertificate());
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+
+        QByteArray ticket;
+        if (resume) {
+            ticket = handshake(server.serverPort(), {}, true);
+            QVERIFY(!ticket.isEmpty());
+        }
+
+        const int handshakesBefore = server.handshakes();
+        int rounds = 0;
+        QBENCHMARK {
+            handshake(server.serverPort(), ticket, false);
+            rounds++;
+        }
+        QTRY_COMPARE(server.handshakes() - handshakesBefore, rounds);
+        QCOMPARE(server.resumedHandshakes(), resume ? rounds : 0);
+    }
+
+private:
+    QByteArray handshake(quint16 port, const QByteArray &ticket, bool waitForTicket)
+    {
+        QSslConfiguration configuration = m_configuration;
+        configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        configuration.setSessionTicket(ticket);
+
+        QSslSocket socket;
+        socket.setSslConfiguration(configuration);
+        connect(&socket, &QSslSocket::sslErrors, &socket, [&socket]() {
+            socket.ignoreSslErrors();
+        });
+
+        QEventLoop loop;
+        connect(&socket, waitForTicket ? &QSslSocket::newSessionTicketReceived : &QSslSocket::encrypted, &loop, &QEventLoop::quit);
+        connect(&socket, &QAbstractSocket::errorOccurred, &loop, &QEventLoop::quit);
+        QTimer::singleShot(5000, &loop, &QEventLoop::quit);
+        socket.connectToHostEncrypted(QStringLiteral("127.0.0.1"), port);
+        loop.exec();
+
+        const QByteArray newTicket = socket.sslConfiguration().sessionTicket();
+        socket.disconnectFromHost();
+        return newTicket;
+    }
+
+    QMap<QSsl::KeyAlgorithm, QSslConfiguration> m_configurations;
+    QSslConfiguration m_configuration;
+};
+
+QTEST_GUILESS_MAIN(SslHandshakeBenchmark)
+
+#include "sslhandshakebenchmark.moc"